@@ -0,0 +1,203 @@
+#include <riel/exchange.h>
+
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using riel::execution::Column;
+using riel::execution::Datum;
+using riel::execution::Row;
+
+class ExchangeTest : public ::testing::Test {
+protected:
+  ExchangeTest() : catalog{}, catalogs{}, workers{}, pids{} {}
+
+  ~ExchangeTest() noexcept override;
+
+  void TearDown() override {
+    for (const auto pid : pids) {
+      ::kill(pid, SIGKILL);
+      ::waitpid(pid, nullptr, 0);
+    }
+  }
+
+  /**
+   * Forks a worker process holding only `table` at `path`, which the
+   * coordinator catalog only describes.
+   */
+  std::string Spawn(std::vector<std::string> &&path,
+                    std::vector<Column> &&    columns) {
+    catalog.Describe(std::vector<std::string>{path},
+                     {columns.size(), columns[0].size(), {}});
+
+    const std::string socket = "/tmp/riel-exchange-" +
+                               std::to_string(::getpid()) + "-" +
+                               std::to_string(workers.size()) + ".sock";
+
+    catalogs.push_back(std::make_unique<riel::execution::Catalog>());
+    catalogs.back()->Register(
+        std::move(path),
+        std::make_shared<riel::execution::Table>(std::move(columns)));
+    workers.push_back(
+        std::make_unique<riel::exchange::Worker>(*catalogs.back(), socket));
+
+    const pid_t pid = ::fork();
+    if (0 == pid) {
+      workers.back()->Run();
+      ::_exit(0);
+    }
+    pids.push_back(pid);
+    return socket;
+  }
+
+  riel::execution::Catalog                               catalog;
+  std::vector<std::unique_ptr<riel::execution::Catalog>> catalogs;
+  std::vector<std::unique_ptr<riel::exchange::Worker>>   workers;
+  std::vector<pid_t>                                     pids;
+};
+
+ExchangeTest::~ExchangeTest() noexcept = default;
+
+TEST_F(ExchangeTest, MergePartialAggregatesFromWorkers) {
+  const auto national =
+      Spawn({"RECORDS", "SALES", "NATIONAL"},
+            {{Datum{"FOOD"}, Datum{"FOOD"}, Datum{"TOOLS"}},
+             {Datum{"APPLE"}, Datum{"APPLE"}, Datum{"HAMMER"}}});
+  const auto international =
+      Spawn({"RECORDS", "SALES", "INTERNATIONAL"},
+            {{Datum{"TOOLS"}, Datum{"FOOD"}},
+             {Datum{"HAMMER"}, Datum{"PEAR"}}});
+
+  std::istringstream stream{
+      "Aggregate(group=[{0, 1}])\n"
+      "  Union(all=[true])\n"
+      "    Project(SECTOR=[$0], NAME=[$1])\n"
+      "      Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+      "    Project(SECTOR=[$0], NAME=[$1])\n"
+      "      Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n"};
+  const auto root = riel::StreamParser{stream}.parse();
+
+  const riel::exchange::Coordinator coordinator{
+      catalog,
+      {
+          {{"RECORDS", "SALES", "NATIONAL"}, national},
+          {{"RECORDS", "SALES", "INTERNATIONAL"}, international},
+      }};
+  const auto op = coordinator.Compile(*root);
+
+  EXPECT_EQ((std::vector<Row>{
+                {Datum{"FOOD"}, Datum{"APPLE"}},
+                {Datum{"TOOLS"}, Datum{"HAMMER"}},
+                {Datum{"FOOD"}, Datum{"PEAR"}},
+            }),
+            riel::execution::Materialize(*op));
+}
+
+TEST_F(ExchangeTest, JoinAndSortShardsLocally) {
+  const auto national = Spawn({"RECORDS", "SALES", "NATIONAL"},
+                              {{Datum{"APPLE"}, Datum{"HAMMER"}},
+                               {Datum{1}, Datum{2}}});
+  const auto international =
+      Spawn({"RECORDS", "SALES", "INTERNATIONAL"},
+            {{Datum{"HAMMER"}, Datum{"SAW"}, Datum{"APPLE"}},
+             {Datum{30}, Datum{40}, Datum{10}}});
+
+  std::istringstream stream{
+      "Sort(sort0=[$3], dir0=[DESC])\n"
+      "  Join(condition=[=($0, $2)], joinType=[inner])\n"
+      "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+      "    Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n"};
+  const auto root = riel::StreamParser{stream}.parse();
+
+  const riel::exchange::Coordinator coordinator{
+      catalog,
+      {
+          {{"RECORDS", "SALES", "NATIONAL"}, national},
+          {{"RECORDS", "SALES", "INTERNATIONAL"}, international},
+      }};
+  const auto op = coordinator.Compile(*root);
+
+  EXPECT_EQ((std::vector<Row>{
+                {Datum{"HAMMER"}, Datum{2}, Datum{"HAMMER"}, Datum{30}},
+                {Datum{"APPLE"}, Datum{1}, Datum{"APPLE"}, Datum{10}},
+            }),
+            riel::execution::Materialize(*op));
+}
+
+TEST_F(ExchangeTest, ReportWorkerErrors) {
+  const auto socket = Spawn({"RECORDS", "SALES", "NATIONAL"},
+                            {{Datum{"FOOD"}}, {Datum{"APPLE"}}});
+
+  std::istringstream stream{"Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n"};
+  const auto         root = riel::StreamParser{stream}.parse();
+
+  const riel::exchange::Coordinator coordinator{
+      catalog, {{{"RECORDS", "SALES", "INTERNATIONAL"}, socket}}};
+  const auto op = coordinator.Compile(*root);
+
+  try {
+    riel::execution::Materialize(*op);
+    FAIL() << "Expected a remote failure";
+  } catch (const std::runtime_error &error) {
+    EXPECT_STREQ(
+        "Remote plan failed: Unknown table RECORDS.SALES.INTERNATIONAL",
+        error.what());
+  }
+}
+
+TEST_F(ExchangeTest, ServeConnectionsInTurnUntilStopped) {
+  const std::string socket =
+      "/tmp/riel-exchange-" + std::to_string(::getpid()) + "-local.sock";
+
+  riel::execution::Catalog local;
+  local.Register({"RECORDS", "SALES", "NATIONAL"},
+                 std::make_shared<riel::execution::Table>(
+                     std::vector<Column>{{Datum{"FOOD"}}, {Datum{"APPLE"}}}));
+  catalog.Describe({"RECORDS", "SALES", "NATIONAL"}, {2, 1, {}});
+
+  riel::exchange::Worker worker{local, socket, 1};
+  std::thread            runner{[&worker] { worker.Run(); }};
+
+  std::istringstream stream{"Scan(table=[[RECORDS, SALES, NATIONAL]])\n"};
+  const auto         root = riel::StreamParser{stream}.parse();
+
+  const riel::exchange::Coordinator coordinator{
+      catalog, {{{"RECORDS", "SALES", "NATIONAL"}, socket}}};
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ((std::vector<Row>{{Datum{"FOOD"}, Datum{"APPLE"}}}),
+              riel::execution::Materialize(*coordinator.Compile(*root)));
+  }
+  EXPECT_THROW(catalog.Find({"RECORDS", "SALES", "NATIONAL"}),
+               std::runtime_error);
+
+  worker.Stop();
+  runner.join();
+  EXPECT_EQ(0, worker.active());
+}
+
+TEST(EncodingTest, RejectCorruptBatches) {
+  std::string payload;
+  riel::exchange::Encode(
+      riel::execution::Batch{std::vector<Column>{{Datum{258}, Datum{"AB"}}}},
+      payload);
+
+  EXPECT_EQ(std::string("\0\0\0\0\0\0\0\1", 8), payload.substr(0, 8));
+  EXPECT_EQ(std::string("\0\0\0\0\0\0\1\2", 8), payload.substr(17, 8));
+  EXPECT_EQ((std::vector<Row>{{Datum{258}}, {Datum{"AB"}}}),
+            (std::vector<Row>{riel::exchange::Decode(payload).row(0),
+                              riel::exchange::Decode(payload).row(1)}));
+
+  std::string tagged{payload};
+  tagged[16] = 7;
+  EXPECT_THROW(riel::exchange::Decode(tagged), std::runtime_error);
+
+  std::string wide{payload};
+  wide[0] = 1;
+  EXPECT_THROW(riel::exchange::Decode(wide), std::runtime_error);
+
+  EXPECT_THROW(riel::exchange::Decode(payload.substr(0, payload.size() - 1)),
+               std::runtime_error);
+}
@@ -0,0 +1,309 @@
+#include "exchange.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+namespace riel {
+namespace exchange {
+
+namespace {
+
+std::runtime_error SystemError(const std::string &what) {
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+sockaddr_un Address(const std::string &path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket path too long: " + path);
+  }
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return address;
+}
+
+// Integers travel as 8 bytes, most significant first, whatever the host.
+constexpr std::size_t kIntegerSize = 8;
+
+void Put(std::string &payload, const std::uint64_t value) {
+  for (std::size_t byte = kIntegerSize; 0 < byte--;) {
+    payload.push_back(static_cast<char>(value >> (8 * byte)));
+  }
+}
+
+std::uint64_t Load(const char *const bytes) noexcept {
+  std::uint64_t value = 0;
+  for (std::size_t byte = 0; byte < kIntegerSize; ++byte) {
+    value = value << 8 | static_cast<unsigned char>(bytes[byte]);
+  }
+  return value;
+}
+
+std::uint64_t Take(const std::string &payload, std::size_t &offset) {
+  if (payload.size() - offset < kIntegerSize) {
+    throw std::runtime_error("Truncated batch payload");
+  }
+  const std::uint64_t value = Load(payload.data() + offset);
+  offset += kIntegerSize;
+  return value;
+}
+
+}  // namespace
+
+// = = = = = =
+// Transport
+// = = = = = =
+
+Socket::~Socket() { ::close(descriptor_); }
+
+std::unique_ptr<Socket> Socket::Dial(const std::string &path) {
+  const int descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (0 > descriptor) { throw SystemError("socket"); }
+  auto socket = std::make_unique<Socket>(descriptor);
+
+  const sockaddr_un address = Address(path);
+  if (0 != ::connect(descriptor,
+                     reinterpret_cast<const sockaddr *>(&address),
+                     sizeof(address))) {
+    throw SystemError("connect " + path);
+  }
+  return socket;
+}
+
+std::unique_ptr<Socket> Socket::Listen(const std::string &path) {
+  const int descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (0 > descriptor) { throw SystemError("socket"); }
+  auto socket = std::make_unique<Socket>(descriptor);
+
+  const sockaddr_un address = Address(path);
+  ::unlink(path.c_str());
+  if (0 != ::bind(descriptor,
+                  reinterpret_cast<const sockaddr *>(&address),
+                  sizeof(address))) {
+    throw SystemError("bind " + path);
+  }
+  if (0 != ::listen(descriptor, SOMAXCONN)) {
+    throw SystemError("listen " + path);
+  }
+  return socket;
+}
+
+std::unique_ptr<Socket> Socket::Accept() {
+  for (;;) {
+    const int descriptor = ::accept(descriptor_, nullptr, nullptr);
+    if (0 <= descriptor) { return std::make_unique<Socket>(descriptor); }
+    if (EINTR == errno || ECONNABORTED == errno) { continue; }
+    if (EINVAL == errno) { return nullptr; }
+    throw SystemError("accept");
+  }
+}
+
+void Socket::Shutdown() noexcept { ::shutdown(descriptor_, SHUT_RDWR); }
+
+void Socket::Send(const Frame frame, const std::string &payload) {
+  std::string header;
+  header.push_back(static_cast<char>(frame));
+  Put(header, payload.size());
+  Write(header.data(), header.size());
+  Write(payload.data(), payload.size());
+}
+
+Frame Socket::Receive(std::string &payload) {
+  char header[1 + kIntegerSize];
+  Read(header, sizeof(header));
+
+  const std::uint64_t size = Load(header + 1);
+  if (size > kMaxPayload) {
+    throw std::runtime_error("Exchange frame of " + std::to_string(size) +
+                             " bytes over the limit");
+  }
+
+  payload.resize(size);
+  Read(&payload[0], payload.size());
+  return static_cast<Frame>(header[0]);
+}
+
+void Socket::Write(const char *data, std::size_t size) {
+  while (0 < size) {
+    const ssize_t written = ::send(descriptor_, data, size, MSG_NOSIGNAL);
+    if (0 > written) {
+      if (EINTR == errno) { continue; }
+      throw SystemError("send");
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+}
+
+void Socket::Read(char *data, std::size_t size) {
+  while (0 < size) {
+    const ssize_t read = ::recv(descriptor_, data, size, 0);
+    if (0 > read) {
+      if (EINTR == errno) { continue; }
+      throw SystemError("recv");
+    }
+    if (0 == read) { throw std::runtime_error("Connection closed by peer"); }
+    data += read;
+    size -= static_cast<std::size_t>(read);
+  }
+}
+
+// Batches travel column by column, each value tagged with its variant index.
+// Only batches with rows are sent.
+void Encode(const execution::Batch &batch, std::string &payload) {
+  Put(payload, batch.width());
+  Put(payload, batch.size());
+
+  for (std::size_t c = 0; c < batch.width(); ++c) {
+    for (std::size_t r = 0; r < batch.size(); ++r) {
+      const execution::Datum &datum = batch.at(c, r);
+      payload.push_back(static_cast<char>(datum.index()));
+      if (const auto *integer = std::get_if<std::int64_t>(&datum)) {
+        Put(payload, static_cast<std::uint64_t>(*integer));
+      } else {
+        const auto &string = std::get<std::string>(datum);
+        Put(payload, string.size());
+        payload.append(string);
+      }
+    }
+  }
+}
+
+execution::Batch Decode(const std::string &payload) {
+  std::size_t offset = 0;
+  const auto  width  = Take(payload, offset);
+  const auto  size   = Take(payload, offset);
+
+  // Each value takes its tag and an integer at least.
+  const std::size_t values = (payload.size() - offset) / (1 + kIntegerSize);
+  if (0 == width || 0 == size || size > values || width > values / size) {
+    throw std::runtime_error("Batch of " + std::to_string(width) + "x" +
+                             std::to_string(size) +
+                             " values past its payload");
+  }
+
+  std::vector<execution::Column> columns(width);
+  for (auto &column : columns) {
+    column.reserve(size);
+    for (std::uint64_t r = 0; r < size; ++r) {
+      if (payload.size() == offset) {
+        throw std::runtime_error("Truncated batch payload");
+      }
+      const auto tag = static_cast<unsigned char>(payload[offset++]);
+      if (0 == tag) {
+        column.emplace_back(static_cast<std::int64_t>(Take(payload, offset)));
+        continue;
+      }
+      if (1 != tag) {
+        throw std::runtime_error("Unknown datum tag " + std::to_string(tag));
+      }
+
+      const auto length = Take(payload, offset);
+      if (payload.size() - offset < length) {
+        throw std::runtime_error("Truncated batch payload");
+      }
+      column.emplace_back(payload.substr(offset, length));
+      offset += length;
+    }
+  }
+  return execution::Batch{std::move(columns)};
+}
+
+// = = = = = = = = = = = =
+// Workers and coordinator
+// = = = = = = = = = = = =
+
+ExchangeOperator::~ExchangeOperator() = default;
+
+Worker::Worker(const execution::Catalog &catalog,
+               std::string               path,
+               const std::size_t         max_connections)
+    : catalog_{catalog}, path_{std::move(path)},
+      max_connections_{max_connections}, listener_{Socket::Listen(path_)},
+      mutex_{}, changed_{}, active_{0}, stopped_{false} {
+  if (0 == max_connections_) {
+    throw std::invalid_argument("Workers must serve at least one connection");
+  }
+}
+
+Worker::~Worker() { ::unlink(path_.c_str()); }
+
+void Worker::Run() {
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      changed_.wait(lock, [this] {
+        return stopped_ || active_ < max_connections_;
+      });
+      if (stopped_) { break; }
+    }
+
+    auto connection = listener_->Accept();
+    if (!connection) { break; }
+
+    const std::lock_guard<std::mutex> lock{mutex_};
+    std::thread{[this, accepted = std::move(connection)]() mutable {
+      Serve(*accepted);
+      accepted.reset();
+
+      // Run() may return, and the worker go, as soon as this is seen.
+      const std::lock_guard<std::mutex> done{mutex_};
+      --active_;
+      changed_.notify_all();
+    }}.detach();
+    ++active_;
+  }
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  changed_.wait(lock, [this] { return 0 == active_; });
+}
+
+void Worker::Stop() noexcept {
+  {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    stopped_ = true;
+    changed_.notify_all();
+  }
+  listener_->Shutdown();
+}
+
+void Worker::Serve(Socket &connection) const {
+  try {
+    std::string plan;
+    if (Frame::PLAN != connection.Receive(plan)) {
+      throw std::runtime_error("Expected a plan");
+    }
+
+    std::istringstream stream{plan, std::ios_base::in};
+    const auto         root = StreamParser{stream}.parse();
+
+    const execution::Executor executor{catalog_};
+    const auto                op = executor.Compile(*root);
+
+    execution::Batch batch;
+    while (op->Next(batch)) {
+      if (0 == batch.size()) { continue; }
+
+      std::string payload;
+      Encode(batch, payload);
+      connection.Send(Frame::BATCH, payload);
+    }
+    connection.Send(Frame::END, {});
+  } catch (const std::exception &error) {
+    try {
+      connection.Send(Frame::ERROR, error.what());
+    } catch (const std::exception &) {
+      // The coordinator is gone; nobody is left to report to.
+    }
+  }
+}
+
+Coordinator::~Coordinator() = default;
+
+}  // namespace exchange
+}  // namespace riel
@@ -0,0 +1,266 @@
+#ifndef RIEL_EXCHANGE_H_
+#define RIEL_EXCHANGE_H_
+
+#include "execution.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string>
+
+namespace riel {
+namespace exchange {
+
+// = = = = = =
+// Transport
+// = = = = = =
+
+/**
+ * Message kinds. Every message is the kind byte, a 64-bit payload length and
+ * the payload. A coordinator sends one PLAN and the worker answers with BATCH
+ * messages closed by END, or with a single ERROR.
+ */
+enum class Frame : char {
+  PLAN  = 'P',
+  BATCH = 'B',
+  END   = 'E',
+  ERROR = 'X',
+};
+
+/**
+ * Unix stream socket owning its descriptor.
+ */
+class RIEL_EXPORT Socket {
+public:
+  /** Largest frame payload accepted, as a bound on a corrupt length. */
+  static constexpr std::uint64_t kMaxPayload = std::uint64_t{1} << 32;
+
+  explicit Socket(const int descriptor) noexcept : descriptor_{descriptor} {}
+
+  ~Socket();
+
+  /** Connects to the worker listening at `path`. */
+  static std::unique_ptr<Socket> Dial(const std::string &path);
+
+  /** Binds and listens at `path`, replacing any stale socket file. */
+  static std::unique_ptr<Socket> Listen(const std::string &path);
+
+  /** Waits for the next connection. Returns null once shut down. */
+  std::unique_ptr<Socket> Accept();
+
+  /** Wakes up any Accept() waiting on this socket. */
+  void Shutdown() noexcept;
+
+  void Send(Frame frame, const std::string &payload);
+
+  Frame Receive(std::string &payload);
+
+private:
+  void Write(const char *data, std::size_t size);
+  void Read(char *data, std::size_t size);
+
+  const int descriptor_;
+
+  RIEL_DISALLOW_ALL(Socket);
+};
+
+void RIEL_EXPORT Encode(const execution::Batch &batch, std::string &payload);
+
+execution::Batch RIEL_EXPORT Decode(const std::string &payload);
+
+// = = = = =
+// Operator
+// = = = = =
+
+/**
+ * Streams the batches of a plan executed by a remote worker.
+ */
+class RIEL_EXPORT ExchangeOperator : public execution::Operator {
+public:
+  ExchangeOperator(std::unique_ptr<Socket> &&connection, std::string plan)
+      : Operator{"Exchange"}, connection_{std::move(connection)},
+        plan_{std::move(plan)} {}
+
+  ~ExchangeOperator() final;
+
+protected:
+  bool Produce(execution::Batch &batch) final {
+    if (!connection_) { return false; }
+    if (!plan_.empty()) {
+      connection_->Send(Frame::PLAN, plan_);
+      plan_.clear();
+    }
+
+    std::string payload;
+    switch (connection_->Receive(payload)) {
+    case Frame::BATCH:
+      batch = Decode(payload);
+      return true;
+    case Frame::END:
+      connection_.reset();
+      return false;
+    case Frame::ERROR:
+      throw std::runtime_error("Remote plan failed: " + payload);
+    case Frame::PLAN:
+      break;
+    }
+    throw std::runtime_error("Unexpected exchange frame");
+  }
+
+private:
+  std::unique_ptr<Socket> connection_;
+  std::string             plan_;
+
+  RIEL_DISALLOW_ALL(ExchangeOperator);
+};
+
+// = = = = = = = = = = = =
+// Workers and coordinator
+// = = = = = = = = = = = =
+
+/**
+ * Executes plans received on a Unix socket against its local catalog. Each
+ * connection is served by its own detached thread, up to `max_connections`
+ * at a time; further ones wait in the listen backlog.
+ */
+class RIEL_EXPORT Worker {
+public:
+  static constexpr std::size_t kDefaultMaxConnections = 64;
+
+  Worker(const execution::Catalog &catalog,
+         std::string               path,
+         std::size_t               max_connections = kDefaultMaxConnections);
+
+  ~Worker();
+
+  /**
+   * Serves connections until Stop() is called, then waits for the ones
+   * being served.
+   */
+  void Run();
+
+  void Stop() noexcept;
+
+  const std::string &path() const noexcept { return path_; }
+
+  /** Connections being served. */
+  std::size_t active() const {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    return active_;
+  }
+
+private:
+  void Serve(Socket &connection) const;
+
+  const execution::Catalog &    catalog_;
+  const std::string             path_;
+  const std::size_t             max_connections_;
+  const std::unique_ptr<Socket> listener_;
+  mutable std::mutex            mutex_;
+  std::condition_variable       changed_;
+  std::size_t                   active_;
+  bool                          stopped_;
+
+  RIEL_DISALLOW_ALL(Worker);
+};
+
+/**
+ * Splits a plan across workers. The largest subtrees whose tables all live on
+ * one worker are shipped to it whole, and the executor compiles the nodes
+ * above them locally, deriving their properties from a catalog that only
+ * needs to describe the tables (see Catalog::Describe); their rows stay on
+ * the workers. An Aggregate over a Union(all=true) spanning several workers
+ * ships a partial aggregate per input and merges the partials locally.
+ */
+class RIEL_EXPORT Coordinator {
+public:
+  /** Socket path of the worker holding each table. */
+  using Placement = std::map<std::vector<std::string>, std::string>;
+
+  Coordinator(const execution::Catalog &catalog, Placement &&placement)
+      : placement_{std::move(placement)},
+        executor_{catalog,
+                  execution::Executor::kDefaultBatchSize,
+                  nullptr,
+                  0,
+                  [this](const Node &node) { return Ship(node); }} {}
+
+  ~Coordinator();
+
+  /** Not reentrant, as Executor::Compile. */
+  std::unique_ptr<execution::Operator> Compile(const Node &node) const {
+    return executor_.Compile(*Partial(node));
+  }
+
+private:
+  /** Exchange with the worker holding the whole subtree, if any does. */
+  std::unique_ptr<execution::Operator> Ship(const Node &node) const {
+    const auto worker = Placed(node);
+    if (!worker) { return nullptr; }
+    return std::make_unique<ExchangeOperator>(Socket::Dial(*worker),
+                                              Format(node));
+  }
+
+  /** Worker holding every table the subtree scans, if a single one does. */
+  std::optional<std::string> Placed(const Node &node) const {
+    if (const auto *scan = dynamic_cast<const ScanNode *>(&node)) {
+      const auto it = placement_.find(scan->path());
+      if (placement_.cend() == it) {
+        throw std::runtime_error("No worker holds the table of " +
+                                 static_cast<std::string>(*scan));
+      }
+      return it->second;
+    }
+
+    std::optional<std::string> worker;
+    for (std::size_t i = 0; i < node.children().size(); ++i) {
+      const auto placed = Placed(*node.children()[i]);
+      if (!placed || (worker && *worker != *placed)) { return {}; }
+      worker = placed;
+    }
+    return worker;
+  }
+
+  /** Copy of the plan with partial aggregates below spanning unions. */
+  std::unique_ptr<Node> Partial(const Node &node) const {
+    auto copy = node.Clone();
+
+    const auto *_union = 0 < node.children().size()
+                             ? dynamic_cast<const UnionNode *>(
+                                   &*node.children()[0])
+                             : nullptr;
+    if (Type::AGGREGATE != node.id() || nullptr == _union ||
+        !_union->all() || Placed(*_union)) {
+      for (std::size_t i = 0; i < node.children().size(); ++i) {
+        copy->children().append(Partial(*node.children()[i]));
+      }
+      return copy;
+    }
+
+    auto merged = _union->Clone();
+    for (std::size_t i = 0; i < _union->children().size(); ++i) {
+      auto partial = node.Clone();
+      partial->children().append(Partial(*_union->children()[i]));
+      merged->children().append(std::move(partial));
+    }
+
+    std::vector<std::size_t> group_indices(
+        dynamic_cast<const AggregateNode &>(node).group_indices().size());
+    std::iota(group_indices.begin(), group_indices.end(), 0);
+    auto merging = std::make_unique<AggregateNode>(std::move(group_indices));
+    merging->children().append(std::move(merged));
+    return merging;
+  }
+
+  const Placement           placement_;
+  const execution::Executor executor_;
+
+  RIEL_DISALLOW_ALL(Coordinator);
+};
+
+}  // namespace exchange
+}  // namespace riel
+
+#endif
@@ -0,0 +1,582 @@
+#include <riel/execution.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using riel::execution::Column;
+using riel::execution::Datum;
+using riel::execution::Row;
+
+class ExecutorTest : public ::testing::Test {
+protected:
+  ExecutorTest() : catalog{} {
+    catalog.Register({"RECORDS", "SALES", "NATIONAL"},
+                     std::make_shared<riel::execution::Table>(
+                         std::vector<Column>{
+                             {Datum{"FOOD"}, Datum{"FOOD"}, Datum{"FOOD"},
+                              Datum{"TOOLS"}},
+                             {Datum{"APPLE"}, Datum{"APPLE"}, Datum{"PEAR"},
+                              Datum{"HAMMER"}},
+                             {Datum{1}, Datum{2}, Datum{3}, Datum{4}},
+                         },
+                         riel::execution::Collation{0, 1}));
+    catalog.Register({"RECORDS", "SALES", "INTERNATIONAL"},
+                     std::make_shared<riel::execution::Table>(
+                         std::vector<Column>{
+                             {Datum{"TOOLS"}, Datum{"FOOD"}, Datum{"TOOLS"}},
+                             {Datum{"SAW"}, Datum{"PEAR"}, Datum{"SAW"}},
+                             {Datum{5}, Datum{6}, Datum{7}},
+                         }));
+  }
+
+  ~ExecutorTest() noexcept;
+
+  std::unique_ptr<riel::Node> Parse(const std::string &plan) {
+    std::istringstream stream{plan};
+    return riel::StreamParser{stream}.parse();
+  }
+
+  riel::execution::Catalog catalog;
+};
+
+ExecutorTest::~ExecutorTest() noexcept = default;
+
+TEST_F(ExecutorTest, StreamingAggregateOverClusteredScan) {
+  const auto root =
+      Parse("Aggregate(group=[{0, 1}])\n"
+            "  Project(NAME=[$1], SECTOR=[$0])\n"
+            "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog, 2};
+  const auto                      op = executor.Compile(*root);
+
+  EXPECT_NE(nullptr,
+            dynamic_cast<riel::execution::StreamingAggregateOperator *>(
+                op.get()));
+  EXPECT_EQ((riel::execution::Collation{1, 0}),
+            executor.properties().Derive(*root).collation);
+
+  riel::execution::Batch batch;
+  ASSERT_TRUE(op->Next(batch));
+  EXPECT_EQ(2, batch.size());
+  EXPECT_EQ((Row{Datum{"APPLE"}, Datum{"FOOD"}}), batch.row(0));
+  EXPECT_EQ((Row{Datum{"PEAR"}, Datum{"FOOD"}}), batch.row(1));
+
+  EXPECT_EQ((std::vector<Row>{{Datum{"HAMMER"}, Datum{"TOOLS"}}}),
+            riel::execution::Materialize(*op));
+}
+
+TEST_F(ExecutorTest, HashAggregateOverUnion) {
+  const auto root =
+      Parse("Aggregate(group=[{0, 1}])\n"
+            "  Union(all=[true])\n"
+            "    Project(SECTOR=[$0], NAME=[$1])\n"
+            "      Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+            "    Project(SECTOR=[$0], NAME=[$1])\n"
+            "      Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  const auto                      op = executor.Compile(*root);
+
+  EXPECT_NE(nullptr,
+            dynamic_cast<riel::execution::HashAggregateOperator *>(op.get()));
+  EXPECT_EQ((std::vector<Row>{
+                {Datum{"FOOD"}, Datum{"APPLE"}},
+                {Datum{"FOOD"}, Datum{"PEAR"}},
+                {Datum{"TOOLS"}, Datum{"HAMMER"}},
+                {Datum{"TOOLS"}, Datum{"SAW"}},
+            }),
+            riel::execution::Materialize(*op));
+}
+
+TEST_F(ExecutorTest, DeriveAgainAfterTableReplaced) {
+  const auto root =
+      Parse("Aggregate(group=[{0, 1}])\n"
+            "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  EXPECT_NE(nullptr,
+            dynamic_cast<riel::execution::StreamingAggregateOperator *>(
+                executor.Compile(*root).get()));
+
+  catalog.Register({"RECORDS", "SALES", "NATIONAL"},
+                   std::make_shared<riel::execution::Table>(
+                       std::vector<Column>{
+                           {Datum{"TOOLS"}, Datum{"FOOD"}, Datum{"TOOLS"}},
+                           {Datum{"SAW"}, Datum{"PEAR"}, Datum{"SAW"}},
+                       }));
+  const auto op = executor.Compile(*root);
+
+  EXPECT_NE(nullptr,
+            dynamic_cast<riel::execution::HashAggregateOperator *>(op.get()));
+  EXPECT_EQ(2, riel::execution::Materialize(*op).size());
+}
+
+TEST_F(ExecutorTest, StackedProjectionsShareScannedColumns) {
+  const auto root =
+      Parse("Union(all=[false])\n"
+            "  Project(SECTOR=[$1])\n"
+            "    Project(NAME=[$1], SECTOR=[$0])\n"
+            "      Scan(table=[[RECORDS, SALES, NATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  const auto                      op = executor.Compile(*root);
+  const auto &                    table =
+      catalog.Find({"RECORDS", "SALES", "NATIONAL"});
+
+  riel::execution::Batch batch;
+  ASSERT_TRUE(op->Next(batch));
+  EXPECT_EQ(table.columns()[0].get(), batch.column(0).get());
+  EXPECT_EQ(2, batch.size());
+  EXPECT_EQ(3, batch.position(1));
+  EXPECT_EQ((Row{Datum{"TOOLS"}}), batch.row(1));
+  EXPECT_FALSE(op->Next(batch));
+}
+
+TEST_F(ExecutorTest, ChargeOperatorsToPlanTracker) {
+  const auto plan = riel::memory::Tracker::Process().MakeChild("plan", 4096);
+  const riel::memory::Scope scope{*plan};
+
+  const auto root =
+      Parse("Aggregate(group=[{0, 1}])\n"
+            "  Union(all=[true])\n"
+            "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+            "    Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  const auto                      op = executor.Compile(*root);
+
+  EXPECT_EQ(4, riel::execution::Materialize(*op).size());
+  EXPECT_LT(0, op->tracker().peak());
+  EXPECT_EQ("process/plan/HashAggregate", op->tracker().path());
+  EXPECT_LE(op->tracker().peak(), plan->peak());
+}
+
+TEST_F(ExecutorTest, ChargeStringPayloadsOfSharedColumns) {
+  const auto plan = riel::memory::Tracker::Process().MakeChild("plan");
+
+  const std::string name(1000, 'N');
+  {
+    const riel::memory::Scope scope{*plan};
+    riel::execution::Batch    batch{std::vector<Column>{
+        {Datum{name}, Datum{name}, Datum{"SAW"}},
+    }};
+
+    EXPECT_EQ(2 * riel::memory::Payload(name),
+              riel::execution::Payload(*batch.column(0)));
+    EXPECT_LE(2 * name.size(), plan->current());
+  }
+  EXPECT_EQ(0, plan->current());
+}
+
+TEST_F(ExecutorTest, FailPlanOverLimitDuringExecution) {
+  std::vector<Column> columns(2);
+  for (std::int64_t i = 0; i < 1024; ++i) {
+    columns[0].emplace_back(i);
+    columns[1].emplace_back(i);
+  }
+  catalog.Register(
+      {"RECORDS", "SALES", "LARGE"},
+      std::make_shared<riel::execution::Table>(std::move(columns)));
+
+  const auto plan = riel::memory::Tracker::Process().MakeChild("plan", 4096);
+  const riel::memory::Scope scope{*plan};
+
+  const auto root = Parse("Aggregate(group=[{0, 1}])\n"
+                          "  Scan(table=[[RECORDS, SALES, LARGE]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  const auto                      op = executor.Compile(*root);
+
+  EXPECT_THROW(riel::execution::Materialize(*op),
+               riel::memory::MemoryLimitExceeded);
+}
+
+class CursorTest : public ::testing::Test {
+protected:
+  /** Endless source of one-row batches counting how many were pulled. */
+  class EndlessOperator : public riel::execution::Operator {
+  public:
+    explicit EndlessOperator(std::atomic<std::size_t> &pulled)
+        : Operator{"Endless"}, pulled_{pulled} {}
+
+    ~EndlessOperator() final;
+
+  protected:
+    bool Produce(riel::execution::Batch &batch) final {
+      const auto value = static_cast<std::int64_t>(pulled_++);
+      batch = riel::execution::Batch{std::vector<Column>{{Datum{value}}}};
+      return true;
+    }
+
+  private:
+    std::atomic<std::size_t> &pulled_;
+  };
+
+  class FailingOperator : public riel::execution::Operator {
+  public:
+    FailingOperator() : Operator{"Failing"} {}
+
+    ~FailingOperator() final;
+
+  protected:
+    bool Produce(riel::execution::Batch & /*batch*/) final {
+      throw std::runtime_error("Scan failed");
+    }
+  };
+
+  ~CursorTest() noexcept;
+};
+
+CursorTest::~CursorTest() noexcept = default;
+
+CursorTest::EndlessOperator::~EndlessOperator() = default;
+CursorTest::FailingOperator::~FailingOperator() = default;
+
+TEST_F(ExecutorTest, CursorSplitsBatches) {
+  const auto root = Parse("Scan(table=[[RECORDS, SALES, NATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  riel::execution::Cursor         cursor{executor.Compile(*root), 3};
+
+  riel::execution::Batch batch;
+  ASSERT_TRUE(cursor.next_batch(batch));
+  EXPECT_EQ(3, batch.size());
+  ASSERT_TRUE(cursor.next_batch(batch));
+  EXPECT_EQ(1, batch.size());
+  EXPECT_EQ((Row{Datum{"TOOLS"}, Datum{"HAMMER"}, Datum{4}}), batch.row(0));
+  EXPECT_FALSE(cursor.next_batch(batch));
+}
+
+TEST_F(CursorTest, BoundProducerAndTerminateEarly) {
+  std::atomic<std::size_t> pulled{0};
+  {
+    riel::execution::Cursor cursor{
+        std::make_unique<EndlessOperator>(pulled), 1, 2};
+
+    riel::execution::Batch batch;
+    ASSERT_TRUE(cursor.next_batch(batch));
+    EXPECT_EQ((Row{Datum{0}}), batch.row(0));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    EXPECT_GE(4, pulled.load());
+  }
+  EXPECT_GE(4, pulled.load());
+}
+
+TEST_F(CursorTest, RethrowProducerErrors) {
+  riel::execution::Cursor cursor{std::make_unique<FailingOperator>()};
+
+  riel::execution::Batch batch;
+  EXPECT_THROW(cursor.next_batch(batch), std::runtime_error);
+  EXPECT_FALSE(cursor.next_batch(batch));
+}
+
+TEST_F(CursorTest, RejectEmptyBatchesAndQueue) {
+  std::atomic<std::size_t> pulled{0};
+  EXPECT_THROW(riel::execution::Cursor(
+                   std::make_unique<EndlessOperator>(pulled), 0),
+               std::invalid_argument);
+  EXPECT_THROW(riel::execution::Cursor(
+                   std::make_unique<EndlessOperator>(pulled), 1, 0),
+               std::invalid_argument);
+  EXPECT_EQ(0, pulled.load());
+}
+
+TEST_F(ExecutorTest, ReuseCachedSubplanUntilTableChanges) {
+  const auto root =
+      Parse("Aggregate(group=[{0}])\n"
+            "  Project(SECTOR=[$0], NAME=[$1])\n"
+            "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n");
+
+  riel::execution::ResultCache    cache{1 << 20};
+  const riel::execution::Executor executor{
+      catalog, riel::execution::Executor::kDefaultBatchSize, &cache};
+
+  const std::vector<Row> expected{{Datum{"FOOD"}}, {Datum{"TOOLS"}}};
+
+  EXPECT_EQ(expected, riel::execution::Materialize(*executor.Compile(*root)));
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_LT(0, cache.bytes());
+
+  const auto cached = executor.Compile(*root);
+  EXPECT_NE(nullptr,
+            dynamic_cast<riel::execution::CachedOperator *>(cached.get()));
+  EXPECT_EQ(expected, riel::execution::Materialize(*cached));
+  EXPECT_EQ(1, cache.hits());
+
+  catalog.Register({"RECORDS", "SALES", "NATIONAL"},
+                   std::make_shared<riel::execution::Table>(std::vector<Column>{
+                       {Datum{"TOYS"}}, {Datum{"BALL"}}}));
+  EXPECT_EQ(0, cache.bytes());
+
+  EXPECT_EQ((std::vector<Row>{{Datum{"TOYS"}}}),
+            riel::execution::Materialize(*executor.Compile(*root)));
+  EXPECT_EQ(1, cache.hits());
+}
+
+TEST_F(ExecutorTest, EvictLeastRecentlyUsedSubplans) {
+  const auto national = Parse("Project(NAME=[$1])\n"
+                              "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n");
+  const auto international =
+      Parse("Project(NAME=[$1])\n"
+            "  Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n");
+
+  const auto names = [this](std::vector<std::string> &&path) {
+    const auto &table = catalog.Find(path);
+    return riel::execution::ResultCache::Bytes(
+        {riel::execution::Batch{table.columns(), 0, table.rows()}.Remap({1})});
+  };
+  const auto national_bytes =
+      riel::Format(*national).size() + names({"RECORDS", "SALES", "NATIONAL"});
+  const auto international_bytes =
+      riel::Format(*international).size() +
+      names({"RECORDS", "SALES", "INTERNATIONAL"});
+
+  riel::execution::ResultCache cache{
+      std::max(national_bytes, international_bytes)};
+  const riel::execution::Executor executor{
+      catalog, riel::execution::Executor::kDefaultBatchSize, &cache};
+
+  riel::execution::Materialize(*executor.Compile(*national));
+  EXPECT_EQ(national_bytes, cache.bytes());
+  riel::execution::Materialize(*executor.Compile(*international));
+  EXPECT_EQ(international_bytes, cache.bytes());
+
+  EXPECT_EQ(nullptr,
+            dynamic_cast<riel::execution::CachedOperator *>(
+                executor.Compile(*national).get()));
+  EXPECT_NE(nullptr,
+            dynamic_cast<riel::execution::CachedOperator *>(
+                executor.Compile(*international).get()));
+}
+
+TEST_F(ExecutorTest, ListenToCatalogFromConcurrentExecutors) {
+  riel::execution::ResultCache cache{1 << 20};
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([this, &cache] {
+      for (int i = 0; i < 100; ++i) {
+        const riel::execution::Executor executor{
+            catalog, riel::execution::Executor::kDefaultBatchSize, &cache};
+      }
+    });
+  }
+  for (std::int64_t i = 0; i < 100; ++i) {
+    catalog.Register({"RECORDS", "SALES", "COUNTER"},
+                     std::make_shared<riel::execution::Table>(
+                         std::vector<Column>{{Datum{i}}}));
+  }
+  for (auto &thread : threads) { thread.join(); }
+
+  EXPECT_EQ(1, catalog.Find({"RECORDS", "SALES", "COUNTER"}).rows());
+}
+
+TEST_F(ExecutorTest, PushFiltersIntoScanAndSkipBlocks) {
+  std::vector<Column> columns(2);
+  for (std::int64_t i = 0; i < 8; ++i) {
+    columns[0].emplace_back(i);
+    columns[1].emplace_back(std::string(1, static_cast<char>('A' + i % 2)));
+  }
+  catalog.Register({"RECORDS", "SALES", "BLOCKS"},
+                   std::make_shared<riel::execution::Table>(
+                       std::move(columns), riel::execution::Collation{0}, 2));
+
+  const auto root =
+      Parse("Project(LETTER=[$0])\n"
+            "  Filter(condition=[AND(>($1, 2), <($1, 6))])\n"
+            "    Project(LETTER=[$1], NUMBER=[$0])\n"
+            "      Filter(condition=[=($1, 'B')])\n"
+            "        Scan(table=[[RECORDS, SALES, BLOCKS]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  const auto                      op = executor.Compile(*root);
+
+  EXPECT_EQ((std::vector<Row>{{Datum{"B"}}, {Datum{"B"}}}),
+            riel::execution::Materialize(*op));
+}
+
+TEST_F(ExecutorTest, SkipBlocksOutsideZoneMaps) {
+  std::vector<Column> columns(1);
+  for (std::int64_t i = 0; i < 8; ++i) { columns[0].emplace_back(i); }
+  const riel::execution::Table table{
+      std::move(columns), riel::execution::Collation{0}, 2};
+
+  riel::execution::ScanOperator scan{
+      table,
+      riel::execution::Executor::kDefaultBatchSize,
+      {{0, riel::Literal{std::int64_t{5}}, riel::Comparator::GREATER_THAN}}};
+
+  EXPECT_EQ((std::vector<Row>{{Datum{6}}, {Datum{7}}}),
+            riel::execution::Materialize(scan));
+  EXPECT_EQ(3, scan.skipped_blocks());
+}
+
+TEST_F(ExecutorTest, RejectMalformedPredicates) {
+  const riel::execution::Executor executor{catalog};
+
+  EXPECT_THROW(executor.Compile(
+                   *Parse("Filter(condition=[=($1, 'PEAR')])\n"
+                          "  Project(NAME=[$1])\n"
+                          "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n")),
+               std::runtime_error);
+  EXPECT_THROW(executor.Compile(
+                   *Parse("Filter(condition=[>($1, 3)])\n"
+                          "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n")),
+               std::runtime_error);
+
+  std::vector<Column> columns(1);
+  columns[0].emplace_back(1);
+  EXPECT_THROW(riel::execution::Table(
+                   std::move(columns), riel::execution::Collation{}, 0),
+               std::invalid_argument);
+  EXPECT_THROW(riel::execution::Table(
+                   std::vector<Column>{{Datum{1}, Datum{"ONE"}}}),
+               std::invalid_argument);
+}
+
+TEST_F(ExecutorTest, HashJoinBuildsSmallerInput) {
+  const auto root =
+      Parse("Filter(condition=[<>($3, 'TOOLS')])\n"
+            "  Join(condition=[=($1, $4)], joinType=[inner])\n"
+            "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+            "    Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  const auto                      op = executor.Compile(*root);
+
+  EXPECT_EQ(
+      (std::vector<Row>{{Datum{"FOOD"},
+                         Datum{"PEAR"},
+                         Datum{3},
+                         Datum{"FOOD"},
+                         Datum{"PEAR"},
+                         Datum{6}}}),
+      riel::execution::Materialize(*op));
+  EXPECT_EQ((riel::execution::Collation{0, 1}),
+            executor.properties().Derive(*root->children()[0]).collation);
+}
+
+TEST_F(ExecutorTest, PartitionLargeHashJoinBuilds) {
+  std::vector<Column> facts(1);
+  for (std::int64_t i = 0; i < 12000; ++i) { facts[0].emplace_back(i); }
+  std::vector<Column> dimensions(2);
+  for (std::int64_t i = 0; i < 9000; ++i) {
+    dimensions[0].emplace_back(2 * i);
+    dimensions[1].emplace_back(i);
+  }
+  catalog.Register(
+      {"RECORDS", "SALES", "FACTS"},
+      std::make_shared<riel::execution::Table>(std::move(facts)));
+  catalog.Register(
+      {"RECORDS", "SALES", "DIMENSIONS"},
+      std::make_shared<riel::execution::Table>(std::move(dimensions)));
+
+  const auto root =
+      Parse("Join(condition=[=($0, $1)], joinType=[inner])\n"
+            "  Scan(table=[[RECORDS, SALES, FACTS]])\n"
+            "  Scan(table=[[RECORDS, SALES, DIMENSIONS]])\n");
+
+  const riel::execution::Executor executor{
+      catalog, riel::execution::Executor::kDefaultBatchSize, nullptr, 4};
+  const auto  op = executor.Compile(*root);
+  const auto *join =
+      dynamic_cast<riel::execution::HashJoinOperator *>(op.get());
+  ASSERT_NE(nullptr, join);
+  EXPECT_EQ(3, join->partitions());
+
+  const auto rows = riel::execution::Materialize(*op);
+  EXPECT_EQ(6000, rows.size());
+  for (const auto &row : rows) {
+    EXPECT_EQ(row[0], row[1]);
+    EXPECT_EQ(std::get<std::int64_t>(row[1]),
+              2 * std::get<std::int64_t>(row[2]));
+  }
+}
+
+TEST_F(ExecutorTest, DropRowsOutsideRuntimeFilter) {
+  std::vector<Column> columns(1);
+  for (std::int64_t i = 0; i < 8; ++i) { columns[0].emplace_back(i); }
+  const riel::execution::Table table{std::move(columns)};
+
+  auto bloom = std::make_shared<riel::execution::BloomFilter>(2);
+  for (const std::int64_t key : {2, 5}) {
+    riel::execution::Batch batch{{{Datum{key}}}};
+    bloom->Insert(riel::execution::KeyHash(batch, {0}, 0));
+  }
+
+  riel::execution::ScanOperator scan{
+      table, riel::execution::Executor::kDefaultBatchSize, {}, {{bloom, {0}}}};
+
+  EXPECT_EQ((std::vector<Row>{{Datum{2}}, {Datum{5}}}),
+            riel::execution::Materialize(scan));
+  EXPECT_EQ(6, scan.filtered_rows());
+}
+
+TEST_F(ExecutorTest, SortInParallelRuns) {
+  std::vector<Column> columns(2);
+  for (std::int64_t i = 0; i < 10000; ++i) {
+    columns[0].emplace_back(std::string(1, static_cast<char>('A' + i % 3)));
+    columns[1].emplace_back((i * 7919) % 10000 - 5000);
+  }
+  catalog.Register(
+      {"RECORDS", "SALES", "NUMBERS"},
+      std::make_shared<riel::execution::Table>(std::move(columns)));
+
+  const auto root =
+      Parse("Sort(sort0=[$0], sort1=[$1], dir0=[DESC], dir1=[ASC])\n"
+            "  Scan(table=[[RECORDS, SALES, NUMBERS]])\n");
+
+  const riel::execution::Executor executor{
+      catalog, riel::execution::Executor::kDefaultBatchSize, nullptr, 4};
+  const auto  op   = executor.Compile(*root);
+  const auto *sort = dynamic_cast<riel::execution::SortOperator *>(op.get());
+  ASSERT_NE(nullptr, sort);
+  EXPECT_EQ(3, sort->runs());
+
+  const auto rows = riel::execution::Materialize(*op);
+  ASSERT_EQ(10000, rows.size());
+  EXPECT_EQ(Datum{"C"}, rows.front()[0]);
+  EXPECT_EQ(Datum{"A"}, rows.back()[0]);
+  for (std::size_t i = 1; i < rows.size(); ++i) {
+    EXPECT_TRUE(rows[i - 1][0] > rows[i][0] ||
+                (rows[i - 1][0] == rows[i][0] && rows[i - 1][1] < rows[i][1]));
+  }
+}
+
+TEST_F(ExecutorTest, FetchTopRowsWithoutSortingAll) {
+  const auto root =
+      Parse("Sort(sort0=[$2], dir0=[DESC], fetch=[2])\n"
+            "  Union(all=[true])\n"
+            "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+            "    Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog, 2};
+  const auto                      op = executor.Compile(*root);
+
+  EXPECT_NE(nullptr,
+            dynamic_cast<riel::execution::TopNOperator *>(op.get()));
+  EXPECT_EQ((std::vector<Row>{
+                {Datum{"TOOLS"}, Datum{"SAW"}, Datum{7}},
+                {Datum{"FOOD"}, Datum{"PEAR"}, Datum{6}},
+            }),
+            riel::execution::Materialize(*op));
+}
+
+TEST_F(ExecutorTest, LimitInputAlreadySorted) {
+  const auto root =
+      Parse("Filter(condition=[<>($1, 'APPLE')])\n"
+            "  Sort(sort0=[$0], dir0=[ASC], fetch=[2])\n"
+            "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n");
+
+  const riel::execution::Executor executor{catalog};
+  const auto                      op = executor.Compile(*root);
+
+  EXPECT_EQ((std::vector<Row>{}), riel::execution::Materialize(*op));
+  EXPECT_EQ((riel::execution::Collation{0}),
+            executor.properties().Derive(*root->children()[0]).collation);
+}
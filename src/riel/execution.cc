@@ -0,0 +1,39 @@
+#include "execution.h"
+
+namespace riel {
+namespace execution {
+
+Table::~Table()     = default;
+Catalog::~Catalog() = default;
+
+PropertiesDeriver::~PropertiesDeriver() = default;
+
+Operator::~Operator() = default;
+
+ScanOperator::~ScanOperator()                             = default;
+ProjectOperator::~ProjectOperator()                       = default;
+FilterOperator::~FilterOperator()                         = default;
+UnionOperator::~UnionOperator()                           = default;
+HashAggregateOperator::~HashAggregateOperator()           = default;
+StreamingAggregateOperator::~StreamingAggregateOperator() = default;
+HashJoinOperator::~HashJoinOperator()                     = default;
+SortOperator::~SortOperator()                             = default;
+TopNOperator::~TopNOperator()                             = default;
+LimitOperator::~LimitOperator()                           = default;
+
+ResultCache::~ResultCache() = default;
+
+CachedOperator::~CachedOperator()   = default;
+CachingOperator::~CachingOperator() = default;
+
+Executor::~Executor() {
+  if (nullptr != cache_) { catalog_.Ignore(listener_); }
+}
+
+Cursor::~Cursor() {
+  Cancel();
+  producer_.join();
+}
+
+}  // namespace execution
+}  // namespace riel
@@ -0,0 +1,2390 @@
+#ifndef RIEL_EXECUTION_H_
+#define RIEL_EXECUTION_H_
+
+#include "riel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace riel {
+namespace execution {
+
+// = = = =
+// Values
+// = = = =
+
+using Datum  = Literal;
+using Column = std::vector<Datum, memory::Allocator<Datum>>;
+using Row    = std::vector<Datum, memory::Allocator<Datum>>;
+
+/** Heap bytes of `datum` beyond the object. */
+inline std::size_t Payload(const Datum &datum) noexcept {
+  const auto *string = std::get_if<std::string>(&datum);
+  return string ? memory::Payload(*string) : 0;
+}
+
+/**
+ * Heap bytes of the strings in `values`; the buffer itself is charged by its
+ * allocator.
+ */
+inline std::size_t Payload(const Column &values) noexcept {
+  std::size_t bytes = 0;
+  for (const auto &datum : values) { bytes += Payload(datum); }
+  return bytes;
+}
+
+/**
+ * Moves `column` behind a shared pointer that keeps its string payloads
+ * charged to the tracker of its allocator for as long as it is shared.
+ */
+inline std::shared_ptr<const Column> Share(Column &&column) {
+  struct Charged {
+    explicit Charged(Column &&values)
+        : column{std::move(values)},
+          payload{column.get_allocator().tracker(), Payload(column)} {}
+
+    const Column              column;
+    const memory::Reservation payload;
+  };
+  auto charged = std::make_shared<const Charged>(std::move(column));
+  return {charged, &charged->column};
+}
+
+/** Mixes the hash of `datum` into `seed`. */
+inline std::size_t HashCombine(const std::size_t seed, const Datum &datum) {
+  return seed ^ (std::hash<Datum>{}(datum) + 0x9e3779b97f4a7c15UL +
+                 (seed << 6) + (seed >> 2));
+}
+
+struct RIEL_EXPORT RowHash {
+  std::size_t operator()(const Row &row) const noexcept {
+    std::size_t seed = row.size();
+    for (const auto &datum : row) { seed = HashCombine(seed, datum); }
+    return seed;
+  }
+};
+
+using Rows   = std::vector<Row, memory::Allocator<Row>>;
+using RowSet = std::
+    unordered_set<Row, RowHash, std::equal_to<Row>, memory::Allocator<Row>>;
+
+/**
+ * Column indices the rows are sorted on, most significant first (ascending).
+ */
+using Collation = std::vector<std::size_t>;
+
+/**
+ * Whether rows sorted by `collation` have all equal `keys` adjacent.
+ */
+inline bool IsSortedOn(const Collation &               collation,
+                       const std::vector<std::size_t> &keys) {
+  if (keys.empty() || keys.size() > collation.size()) { return false; }
+  return std::is_permutation(keys.cbegin(), keys.cend(), collation.cbegin());
+}
+
+// = = = = = = =
+// Predicates
+// = = = = = = =
+
+/** Conjunction of comparisons over the columns of a batch. */
+using Predicates = std::vector<Comparison>;
+
+/**
+ * Whether `datum` satisfies `comparison`. Integers and strings do not compare,
+ * so a literal of the other type is an error rather than a variant ordering.
+ */
+inline bool Satisfies(const Datum &datum, const Comparison &comparison) {
+  if (datum.index() != comparison.literal.index()) {
+    throw std::runtime_error("Comparison of $" +
+                             std::to_string(comparison.index) +
+                             " with a literal of another type");
+  }
+  switch (comparison.comparator) {
+  case Comparator::EQUALS:
+    return datum == comparison.literal;
+  case Comparator::NOT_EQUALS:
+    return datum != comparison.literal;
+  case Comparator::LESS_THAN:
+    return datum < comparison.literal;
+  case Comparator::LESS_THAN_OR_EQUAL:
+    return datum <= comparison.literal;
+  case Comparator::GREATER_THAN:
+    return datum > comparison.literal;
+  case Comparator::GREATER_THAN_OR_EQUAL:
+    return datum >= comparison.literal;
+  }
+  return false;
+}
+
+/**
+ * Minimum and maximum of a column over one block of rows.
+ */
+struct RIEL_EXPORT Zone {
+  Datum min;
+  Datum max;
+
+  /** Whether some value within the bounds may satisfy `comparison`. */
+  bool MayMatch(const Comparison &comparison) const {
+    const Literal &literal = comparison.literal;
+    switch (comparison.comparator) {
+    case Comparator::EQUALS:
+      return min <= literal && literal <= max;
+    case Comparator::NOT_EQUALS:
+      return min != literal || max != literal;
+    case Comparator::LESS_THAN:
+      return min < literal;
+    case Comparator::LESS_THAN_OR_EQUAL:
+      return min <= literal;
+    case Comparator::GREATER_THAN:
+      return max > literal;
+    case Comparator::GREATER_THAN_OR_EQUAL:
+      return max >= literal;
+    }
+    return true;
+  }
+};
+
+// = = = =
+// Batch
+// = = = =
+
+using Selection = std::vector<std::size_t, memory::Allocator<std::size_t>>;
+
+/**
+ * A window of rows over shared, immutable columns. Rows are either a
+ * contiguous range or picked by a selection vector; operators narrow or remap
+ * a batch without copying column data, and rows are only built by `row()`.
+ */
+class RIEL_EXPORT Batch {
+public:
+  using ColumnPtr = std::shared_ptr<const Column>;
+
+  inline Batch() : columns_{}, selection_{}, offset_{0}, length_{0} {}
+
+  explicit Batch(std::vector<Column> &&columns)
+      : columns_{}, selection_{}, offset_{0}, length_{0} {
+    length_ = columns.empty() ? 0 : columns[0].size();
+    columns_.reserve(columns.size());
+    for (auto &column : columns) {
+      columns_.push_back(Share(std::move(column)));
+    }
+  }
+
+  Batch(std::vector<ColumnPtr> columns,
+        const std::size_t      offset,
+        const std::size_t      length)
+      : columns_{std::move(columns)}, selection_{}, offset_{offset},
+        length_{length} {}
+
+  std::size_t size() const noexcept {
+    return selection_ ? selection_->size() : length_;
+  }
+
+  std::size_t width() const noexcept { return columns_.size(); }
+
+  const ColumnPtr &column(const std::size_t index) const noexcept {
+    return columns_[index];
+  }
+
+  /** Position in the underlying columns of the `row_index`-th row. */
+  std::size_t position(const std::size_t row_index) const noexcept {
+    return selection_ ? (*selection_)[row_index] : offset_ + row_index;
+  }
+
+  const Datum &at(const std::size_t column_index,
+                  const std::size_t row_index) const noexcept {
+    return (*columns_[column_index])[position(row_index)];
+  }
+
+  Row row(const std::size_t row_index) const {
+    const std::size_t position_index = position(row_index);
+
+    Row row;
+    row.reserve(columns_.size());
+    for (const auto &column : columns_) {
+      row.push_back((*column)[position_index]);
+    }
+    return row;
+  }
+
+  /** Same rows over the columns at `indices`. */
+  Batch Remap(const std::vector<std::size_t> &indices) const {
+    Batch batch;
+    batch.columns_.reserve(indices.size());
+    for (const auto index : indices) {
+      batch.columns_.push_back(columns_[index]);
+    }
+    batch.selection_ = selection_;
+    batch.offset_    = offset_;
+    batch.length_    = length_;
+    return batch;
+  }
+
+  /** The rows at `row_indices`, relative to this batch. */
+  Batch Select(const Selection &row_indices) const {
+    auto selection = std::make_shared<Selection>();
+    selection->reserve(row_indices.size());
+    for (const auto index : row_indices) {
+      selection->push_back(position(index));
+    }
+
+    Batch batch;
+    batch.columns_   = columns_;
+    batch.selection_ = std::move(selection);
+    return batch;
+  }
+
+  /** The `length` rows from `offset`, relative to this batch. */
+  Batch Slice(const std::size_t offset, const std::size_t length) const {
+    if (!selection_) { return Batch{columns_, offset_ + offset, length}; }
+
+    Selection row_indices(length);
+    std::iota(row_indices.begin(), row_indices.end(), offset);
+    return Select(row_indices);
+  }
+
+private:
+  std::vector<ColumnPtr>           columns_;
+  std::shared_ptr<const Selection> selection_;
+  std::size_t                      offset_;
+  std::size_t                      length_;
+};
+
+/**
+ * Rows of `batch` satisfying every predicate, relative to the batch.
+ */
+inline Selection Evaluate(const Batch &batch, const Predicates &predicates) {
+  Selection selection;
+  for (std::size_t r = 0; r < batch.size(); ++r) {
+    if (std::all_of(
+            predicates.cbegin(), predicates.cend(), [&](const auto &predicate) {
+              return Satisfies(batch.at(predicate.index, r), predicate);
+            })) {
+      selection.push_back(r);
+    }
+  }
+  return selection;
+}
+
+/**
+ * Hash of the values at `indices` in the `row_index`-th row of `batch`. Equal
+ * keys hash equally whichever batch they come from.
+ */
+inline std::size_t KeyHash(const Batch &                   batch,
+                           const std::vector<std::size_t> &indices,
+                           const std::size_t               row_index) {
+  std::size_t seed = indices.size();
+  for (const auto index : indices) {
+    seed = HashCombine(seed, batch.at(index, row_index));
+  }
+  return seed;
+}
+
+// = = = = = = = = =
+// Runtime filters
+// = = = = = = = = =
+
+/**
+ * Spreads the bits of a hash; integers hash to themselves, so their high bits
+ * barely change.
+ */
+inline std::size_t MixHash(std::size_t hash) noexcept {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdUL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53UL;
+  return hash ^ (hash >> 33);
+}
+
+/**
+ * Set of key hashes answering membership with false positives only. Sized
+ * for `expected` keys at about 1% false positives; more keys keep it correct
+ * and only raise that rate.
+ */
+class RIEL_EXPORT BloomFilter {
+public:
+  explicit BloomFilter(const std::size_t expected)
+      : bits_((std::max<std::size_t>(expected, 1) * kBitsPerKey + 63) / 64) {}
+
+  void Insert(const std::size_t hash) noexcept {
+    const std::size_t size = bits_.size() * 64;
+    std::size_t       h1   = MixHash(hash);
+    const std::size_t h2   = (h1 >> 32) | 1;
+    for (std::size_t i = 0; i < kHashes; ++i, h1 += h2) {
+      bits_[h1 % size / 64] |= std::uint64_t{1} << (h1 % 64);
+    }
+  }
+
+  bool MayContain(const std::size_t hash) const noexcept {
+    const std::size_t size = bits_.size() * 64;
+    std::size_t       h1   = MixHash(hash);
+    const std::size_t h2   = (h1 >> 32) | 1;
+    for (std::size_t i = 0; i < kHashes; ++i, h1 += h2) {
+      if (0 == (bits_[h1 % size / 64] & (std::uint64_t{1} << (h1 % 64)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /** Adds the keys of `other`, a filter built for as many keys. */
+  void Merge(const BloomFilter &other) noexcept {
+    for (std::size_t i = 0; i < bits_.size(); ++i) {
+      bits_[i] |= other.bits_[i];
+    }
+  }
+
+private:
+  static constexpr std::size_t kBitsPerKey = 10;
+  static constexpr std::size_t kHashes     = 7;
+
+  std::vector<std::uint64_t> bits_;
+};
+
+/**
+ * Bloom filter over the build keys of a hash join, pushed into the scans of
+ * its probe side. The join fills it before pulling the first probe batch.
+ */
+struct RIEL_EXPORT RuntimeFilter {
+  std::shared_ptr<const BloomFilter> bloom;
+  std::vector<std::size_t>           indices;
+};
+
+using RuntimeFilters = std::vector<RuntimeFilter>;
+
+// = = = = = = =
+// Table storage
+// = = = = = = =
+
+/**
+ * Immutable columns split in blocks of `block_size` rows, each with a zone
+ * map per column so scans can skip blocks that cannot match. Each column
+ * holds values of a single type, which scans check their predicates against.
+ */
+class RIEL_EXPORT Table {
+public:
+  static constexpr std::size_t kDefaultBlockSize = 4096;
+
+  explicit Table(std::vector<Column> &&columns,
+                 Collation &&          collation  = {},
+                 const std::size_t     block_size = kDefaultBlockSize)
+      : columns_{}, collation_{std::move(collation)}, block_size_{block_size},
+        zones_{} {
+    if (0 == block_size_) {
+      throw std::invalid_argument("Table blocks must hold at least one row");
+    }
+
+    columns_.reserve(columns.size());
+    for (auto &column : columns) {
+      if (std::any_of(column.cbegin(), column.cend(), [&](const auto &datum) {
+            return datum.index() != column.front().index();
+          })) {
+        throw std::invalid_argument("Column $" +
+                                    std::to_string(columns_.size()) +
+                                    " mixes integers and strings");
+      }
+      columns_.push_back(Share(std::move(column)));
+    }
+
+    for (std::size_t begin = 0; begin < rows(); begin += block_size_) {
+      const auto end = std::min(begin + block_size_, rows());
+
+      std::vector<Zone> zones;
+      zones.reserve(columns_.size());
+      for (const auto &column : columns_) {
+        const auto bounds = std::minmax_element(
+            column->cbegin() + static_cast<std::ptrdiff_t>(begin),
+            column->cbegin() + static_cast<std::ptrdiff_t>(end));
+        zones.push_back({*bounds.first, *bounds.second});
+      }
+      zones_.push_back(std::move(zones));
+    }
+  }
+
+  ~Table();
+
+  std::size_t rows() const noexcept {
+    return columns_.empty() ? 0 : columns_[0]->size();
+  }
+
+  std::size_t width() const noexcept { return columns_.size(); }
+
+  const std::vector<Batch::ColumnPtr> &columns() const noexcept {
+    return columns_;
+  }
+
+  /** Clustering order of the stored rows. */
+  const Collation &collation() const noexcept { return collation_; }
+
+  std::size_t block_size() const noexcept { return block_size_; }
+
+  const Zone &zone(const std::size_t block_index,
+                   const std::size_t column_index) const noexcept {
+    return zones_[block_index][column_index];
+  }
+
+private:
+  std::vector<Batch::ColumnPtr>  columns_;
+  Collation                      collation_;
+  const std::size_t              block_size_;
+  std::vector<std::vector<Zone>> zones_;
+
+  RIEL_DISALLOW_ALL(Table);
+};
+
+/**
+ * What planning needs of a table: its shape, estimated size and clustering
+ * order. Enough to derive plan properties where the rows live elsewhere.
+ */
+struct RIEL_EXPORT TableDescription {
+  std::size_t width;
+  std::size_t rows;
+  Collation   collation;
+};
+
+class RIEL_EXPORT Catalog {
+public:
+  /** Called with the path of each table registered. */
+  using Listener = std::function<void(const std::vector<std::string> &)>;
+
+  inline Catalog()
+      : mutex_{}, tables_{}, last_version_{0}, listeners_{},
+        last_listener_{0} {}
+  ~Catalog();
+
+  /**
+   * Registers `table` at `path`, replacing any previous one. Each
+   * registration gets a new version and is announced to the listeners.
+   */
+  void Register(std::vector<std::string> &&path, std::shared_ptr<Table> table) {
+    TableDescription description{
+        table->width(), table->rows(), Collation{table->collation()}};
+    Add(std::move(path), std::move(table), std::move(description));
+  }
+
+  /**
+   * Registers only the description of a table stored elsewhere, as Register
+   * does a table. Plans over it can be derived but not scanned here.
+   */
+  void Describe(std::vector<std::string> &&path,
+                TableDescription &&       description) {
+    Add(std::move(path), nullptr, std::move(description));
+  }
+
+  /**
+   * Calls `listener` on every later registration until ignored with the
+   * returned id. Listening does not change the tables, so it is const, and
+   * it may run concurrently with registrations and other listeners. Calls
+   * happen under the catalog lock: listeners must not call back into it,
+   * and once Ignore() returns the listener is no longer running.
+   */
+  std::size_t Listen(Listener listener) const {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    listeners_.emplace(++last_listener_, std::move(listener));
+    return last_listener_;
+  }
+
+  void Ignore(const std::size_t id) const {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    listeners_.erase(id);
+  }
+
+  const Table &Find(const std::vector<std::string> &path) const {
+    const Entry &entry = Lookup(path);
+    if (!entry.table) {
+      throw std::runtime_error("Table " + Name(path) +
+                               " is only described here");
+    }
+    return *entry.table;
+  }
+
+  const TableDescription &
+  Description(const std::vector<std::string> &path) const {
+    return Lookup(path).description;
+  }
+
+  std::size_t version(const std::vector<std::string> &path) const {
+    return Lookup(path).version;
+  }
+
+private:
+  struct Entry {
+    std::shared_ptr<Table> table;
+    TableDescription       description;
+    std::size_t            version;
+  };
+
+  void Add(std::vector<std::string> &&path,
+           std::shared_ptr<Table>     table,
+           TableDescription &&        description) {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    const auto it = tables_.insert_or_assign(
+        std::move(path),
+        Entry{std::move(table), std::move(description), ++last_version_});
+    for (const auto &listener : listeners_) {
+      listener.second(it.first->first);
+    }
+  }
+
+  const Entry &Lookup(const std::vector<std::string> &path) const {
+    const auto it = tables_.find(path);
+    if (tables_.cend() == it) {
+      throw std::runtime_error("Unknown table " + Name(path));
+    }
+    return it->second;
+  }
+
+  static std::string Name(const std::vector<std::string> &path) {
+    std::ostringstream stream{std::ios_base::out};
+    for (const auto &part : path) { stream << '.' << part; }
+    return stream.str().substr(1);
+  }
+
+  // Serializes registrations and listener changes. Lookups take no lock:
+  // a table must not be replaced while plans are reading it.
+  mutable std::mutex                        mutex_;
+  std::map<std::vector<std::string>, Entry> tables_;
+  std::size_t                               last_version_;
+  mutable std::map<std::size_t, Listener>   listeners_;
+  mutable std::size_t                       last_listener_;
+
+  RIEL_DISALLOW_ALL(Catalog);
+};
+
+// = = = = = = = = =
+// Plan properties
+// = = = = = = = = =
+
+struct RIEL_EXPORT Properties {
+  Collation   collation;
+  std::size_t width;
+  std::size_t rows;  // Estimated.
+};
+
+/** Estimated rows kept by `conjuncts` comparisons, each keeping half. */
+inline std::size_t EstimateFiltered(const std::size_t rows,
+                                    const std::size_t conjuncts) noexcept {
+  return rows >> std::min<std::size_t>(conjuncts, 8);
+}
+
+/** Estimated groups out of `rows` rows: a tenth of them, at least one. */
+inline std::size_t EstimateGroups(const std::size_t rows) noexcept {
+  return 0 == rows ? 0 : std::max<std::size_t>(rows / 10, 1);
+}
+
+/**
+ * Derives bottom-up the physical properties of each node output. Leaf
+ * collations and statistics come from the table storage in the catalog.
+ */
+class RIEL_EXPORT PropertiesDeriver : public Visitor {
+public:
+  explicit PropertiesDeriver(const Catalog &catalog)
+      : catalog_{catalog}, properties_{} {}
+
+  ~PropertiesDeriver() final;
+
+  /**
+   * Properties of the node output, cached by node until the next Reset().
+   */
+  const Properties &Derive(const Node &node) const {
+    const auto it = properties_.find(&node);
+    if (properties_.cend() != it) { return it->second; }
+    node.Accept(*this);
+    return properties_.at(&node);
+  }
+
+  void Visit(const ScanNode &node) const final {
+    const auto &table = catalog_.Description(node.path());
+    properties_[&node] = {table.collation, table.width, table.rows};
+  }
+
+  void Visit(const UnionNode &node) const final {
+    Properties properties = Derive(*node.children()[0]);
+    for (std::size_t i = 1; i < node.children().size(); ++i) {
+      properties.collation.clear();
+      properties.rows += Derive(*node.children()[i]).rows;
+    }
+    properties_[&node] = std::move(properties);
+  }
+
+  void Visit(const AggregateNode &node) const final {
+    const auto &input = Derive(*node.children()[0]);
+    const auto &group = node.group_indices();
+
+    Properties properties{{}, group.size(), EstimateGroups(input.rows)};
+    if (IsSortedOn(input.collation, group)) {
+      for (std::size_t i = 0; i < group.size(); ++i) {
+        const auto it =
+            std::find(group.cbegin(), group.cend(), input.collation[i]);
+        properties.collation.push_back(
+            static_cast<std::size_t>(it - group.cbegin()));
+      }
+    }
+    properties_[&node] = std::move(properties);
+  }
+
+  void Visit(const FilterNode &node) const final {
+    Properties properties = Derive(*node.children()[0]);
+    properties.rows =
+        EstimateFiltered(properties.rows, node.conjuncts().size());
+    properties_[&node] = std::move(properties);
+  }
+
+  void Visit(const ProjectNode &node) const final {
+    const auto &input = Derive(*node.children()[0]);
+    const auto &pairs = node.pairs();
+
+    Properties properties{{}, pairs.size(), input.rows};
+    for (const auto key : input.collation) {
+      const auto it =
+          std::find_if(pairs.cbegin(), pairs.cend(), [key](const auto &pair) {
+            return key == pair.second;
+          });
+      if (pairs.cend() == it) { break; }
+      properties.collation.push_back(
+          static_cast<std::size_t>(it - pairs.cbegin()));
+    }
+    properties_[&node] = std::move(properties);
+  }
+
+  /**
+   * Joins keep the order of their probe side and are assumed to match each
+   * row of the larger input at most once.
+   */
+  void Visit(const JoinNode &node) const final {
+    const auto &left  = Derive(*node.children()[0]);
+    const auto &right = Derive(*node.children()[1]);
+
+    Properties properties{{},
+                          left.width + right.width,
+                          std::max(left.rows, right.rows)};
+    if (!BuildsLeft(left, right)) {
+      properties.collation = left.collation;
+    } else {
+      for (const auto key : right.collation) {
+        properties.collation.push_back(left.width + key);
+      }
+    }
+    properties_[&node] = std::move(properties);
+  }
+
+  /**
+   * Sorts are ordered on their leading ascending keys and keep the order of
+   * their input when only limiting it.
+   */
+  void Visit(const SortNode &node) const final {
+    const auto &input = Derive(*node.children()[0]);
+
+    Properties properties{{}, input.width, input.rows};
+    if (node.keys().empty()) { properties.collation = input.collation; }
+    for (const auto &key : node.keys()) {
+      if (Direction::ASCENDING != key.direction) { break; }
+      properties.collation.push_back(key.index);
+    }
+    if (node.fetch()) {
+      properties.rows = std::min(properties.rows, *node.fetch());
+    }
+    properties_[&node] = std::move(properties);
+  }
+
+  /** Forgets the nodes derived: they may be freed or their tables replaced. */
+  void Reset() const noexcept { properties_.clear(); }
+
+  /** Whether a hash join builds on its left input: the smaller one. */
+  static bool BuildsLeft(const Properties &left, const Properties &right) {
+    return left.rows < right.rows;
+  }
+
+private:
+  const Catalog &                                      catalog_;
+  mutable std::unordered_map<const Node *, Properties> properties_;
+
+  RIEL_DISALLOW_ALL(PropertiesDeriver);
+};
+
+// = = = = = =
+// Operators
+// = = = = = =
+
+/**
+ * Pulls batches from its inputs. Each operator owns a memory tracker under the
+ * one in scope when it was built, and its allocations are charged there.
+ */
+class RIEL_EXPORT Operator {
+public:
+  virtual ~Operator();
+
+  /**
+   * Fills `batch` with the next rows. Returns false once exhausted.
+   */
+  bool Next(Batch &batch) {
+    RIEL_TRACE(label_);
+
+    const memory::Scope scope{*tracker_};
+    return Produce(batch);
+  }
+
+  const memory::Tracker &tracker() const noexcept { return *tracker_; }
+
+protected:
+  /** `label` names the trace events too, so it must be a string literal. */
+  explicit Operator(const char *label)
+      : label_{label}, tracker_{memory::Scope::Current().MakeChild(label)} {}
+
+  virtual bool Produce(Batch &batch) = 0;
+
+  /** Charges this operator, for members built before it is in scope. */
+  template <class T>
+  memory::Allocator<T> allocator() const {
+    return memory::Allocator<T>{tracker_};
+  }
+
+  /** Charges this operator with heap bytes held outside its allocators. */
+  memory::Reservation reservation() const {
+    return memory::Reservation{tracker_, 0};
+  }
+
+private:
+  const char *const                      label_;
+  const std::shared_ptr<memory::Tracker> tracker_;
+
+  RIEL_DISALLOW_ALL(Operator);
+};
+
+/**
+ * Reads a table in batches that never span blocks. Pushed down predicates
+ * skip the blocks whose zone maps rule them out and select the matching rows
+ * of the others; runtime filters then drop the rows no join would match.
+ */
+class RIEL_EXPORT ScanOperator : public Operator {
+public:
+  ScanOperator(const Table &     table,
+               const std::size_t batch_size,
+               Predicates &&     predicates = {},
+               RuntimeFilters && filters    = {})
+      : Operator{"Scan"}, table_{table}, batch_size_{batch_size},
+        predicates_{std::move(predicates)}, filters_{std::move(filters)},
+        offset_{0}, skipped_blocks_{0}, filtered_rows_{0} {
+    for (const auto &predicate : predicates_) {
+      Check(predicate.index);
+      const auto &column = *table_.columns()[predicate.index];
+      if (!column.empty() &&
+          column.front().index() != predicate.literal.index()) {
+        throw std::runtime_error("Comparison of $" +
+                                 std::to_string(predicate.index) +
+                                 " with a literal of another type");
+      }
+    }
+    for (const auto &filter : filters_) {
+      for (const auto index : filter.indices) { Check(index); }
+    }
+  }
+
+  ~ScanOperator() final;
+
+  const Predicates &predicates() const noexcept { return predicates_; }
+
+  const RuntimeFilters &filters() const noexcept { return filters_; }
+
+  std::size_t skipped_blocks() const noexcept { return skipped_blocks_; }
+
+  /** Rows dropped by the runtime filters. */
+  std::size_t filtered_rows() const noexcept { return filtered_rows_; }
+
+protected:
+  bool Produce(Batch &batch) final {
+    const std::size_t block_size = table_.block_size();
+
+    while (offset_ < table_.rows()) {
+      if (0 == offset_ % block_size && !MayMatch(offset_ / block_size)) {
+        offset_ += block_size;
+        ++skipped_blocks_;
+        continue;
+      }
+
+      const std::size_t block_end =
+          std::min(offset_ - offset_ % block_size + block_size, table_.rows());
+      const std::size_t length = std::min(batch_size_, block_end - offset_);
+
+      batch = Batch{table_.columns(), offset_, length};
+      offset_ += length;
+
+      if (predicates_.empty() && filters_.empty()) { return true; }
+      if (Select(batch)) { return true; }
+    }
+    return false;
+  }
+
+private:
+  void Check(const std::size_t index) const {
+    if (index >= table_.width()) {
+      throw std::runtime_error("Scan has no column $" + std::to_string(index));
+    }
+  }
+
+  bool MayMatch(const std::size_t block_index) const {
+    return std::all_of(
+        predicates_.cbegin(), predicates_.cend(), [&](const auto &predicate) {
+          return table_.zone(block_index, predicate.index).MayMatch(predicate);
+        });
+  }
+
+  bool Select(Batch &batch) {
+    Selection selection = Evaluate(batch, predicates_);
+    if (!filters_.empty()) {
+      const auto end = std::remove_if(
+          selection.begin(), selection.end(), [&](const std::size_t r) {
+            return !std::all_of(
+                filters_.cbegin(), filters_.cend(), [&](const auto &filter) {
+                  return filter.bloom->MayContain(
+                      KeyHash(batch, filter.indices, r));
+                });
+          });
+      filtered_rows_ += static_cast<std::size_t>(selection.end() - end);
+      selection.erase(end, selection.end());
+    }
+    if (selection.empty()) { return false; }
+    if (selection.size() != batch.size()) { batch = batch.Select(selection); }
+    return true;
+  }
+
+  const Table &        table_;
+  const std::size_t    batch_size_;
+  const Predicates     predicates_;
+  const RuntimeFilters filters_;
+  std::size_t          offset_;
+  std::size_t          skipped_blocks_;
+  std::size_t          filtered_rows_;
+
+  RIEL_DISALLOW_ALL(ScanOperator);
+};
+
+/**
+ * Narrows the selection of its input batches to the rows satisfying the
+ * predicates.
+ */
+class RIEL_EXPORT FilterOperator : public Operator {
+public:
+  FilterOperator(std::unique_ptr<Operator> &&input, Predicates &&predicates)
+      : Operator{"Filter"}, input_{std::move(input)},
+        predicates_{std::move(predicates)} {}
+
+  ~FilterOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    Batch input;
+    while (input_->Next(input)) {
+      const Selection selection = Evaluate(input, predicates_);
+      if (!selection.empty()) {
+        batch = input.Select(selection);
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  std::unique_ptr<Operator> input_;
+  const Predicates          predicates_;
+
+  RIEL_DISALLOW_ALL(FilterOperator);
+};
+
+/**
+ * Renames and reorders column references; no column data is copied.
+ */
+class RIEL_EXPORT ProjectOperator : public Operator {
+public:
+  ProjectOperator(std::unique_ptr<Operator> &&input,
+                  std::vector<std::size_t> &&  indices)
+      : Operator{"Project"}, input_{std::move(input)},
+        indices_{std::move(indices)} {}
+
+  ~ProjectOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    Batch input;
+    if (!input_->Next(input)) { return false; }
+
+    batch = input.Remap(indices_);
+    return true;
+  }
+
+private:
+  std::unique_ptr<Operator> input_;
+  std::vector<std::size_t>  indices_;
+
+  RIEL_DISALLOW_ALL(ProjectOperator);
+};
+
+class RIEL_EXPORT UnionOperator : public Operator {
+public:
+  UnionOperator(std::vector<std::unique_ptr<Operator>> &&inputs,
+                const bool                               all)
+      : Operator{"Union"}, inputs_{std::move(inputs)},
+        seen_{allocator<Row>()}, payload_{reservation()}, current_{0},
+        all_{all} {}
+
+  ~UnionOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    for (; current_ < inputs_.size(); ++current_) {
+      Batch input;
+      while (inputs_[current_]->Next(input)) {
+        if (all_) {
+          batch = std::move(input);
+          return true;
+        }
+        if (Distinct(input, batch)) { return true; }
+      }
+    }
+    return false;
+  }
+
+private:
+  bool Distinct(const Batch &input, Batch &batch) {
+    Selection selection;
+    for (std::size_t r = 0; r < input.size(); ++r) {
+      const auto inserted = seen_.insert(input.row(r));
+      if (inserted.second) {
+        payload_.Grow(Payload(*inserted.first));
+        selection.push_back(r);
+      }
+    }
+    if (selection.empty()) { return false; }
+
+    batch = input.Select(selection);
+    return true;
+  }
+
+  std::vector<std::unique_ptr<Operator>> inputs_;
+  RowSet                                 seen_;
+  memory::Reservation                    payload_;
+  std::size_t                            current_;
+  const bool                             all_ : __SYSCALL_WORDSIZE;
+
+  RIEL_DISALLOW_ALL(UnionOperator);
+};
+
+/**
+ * Groups by building a hash table over the whole input. Groups are emitted in
+ * order of first appearance once the input is exhausted.
+ */
+class RIEL_EXPORT HashAggregateOperator : public Operator {
+public:
+  HashAggregateOperator(std::unique_ptr<Operator> &&input,
+                        std::vector<std::size_t>    group_indices,
+                        const std::size_t           batch_size)
+      : Operator{"HashAggregate"}, input_{std::move(input)},
+        group_indices_{std::move(group_indices)}, batch_size_{batch_size},
+        groups_{allocator<Row>()}, payload_{reservation()}, offset_{0} {}
+
+  ~HashAggregateOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    if (input_) { Build(); }
+    if (offset_ >= groups_.size()) { return false; }
+
+    const std::size_t   end = std::min(offset_ + batch_size_, groups_.size());
+    std::vector<Column> columns(group_indices_.size());
+    for (; offset_ < end; ++offset_) {
+      payload_.Shrink(Payload(groups_[offset_]));
+      for (std::size_t c = 0; c < columns.size(); ++c) {
+        columns[c].push_back(std::move(groups_[offset_][c]));
+      }
+    }
+
+    batch = Batch{std::move(columns)};
+    return true;
+  }
+
+private:
+  // The keys are held twice while building, once in `seen` and once in
+  // `groups_`, so both copies are charged.
+  void Build() {
+    RowSet              seen;
+    memory::Reservation seen_payload{reservation()};
+    Batch               input;
+    while (input_->Next(input)) {
+      for (std::size_t r = 0; r < input.size(); ++r) {
+        Row key;
+        key.reserve(group_indices_.size());
+        for (const auto index : group_indices_) {
+          key.push_back(input.at(index, r));
+        }
+        if (seen.insert(key).second) {
+          seen_payload.Grow(Payload(key));
+          payload_.Grow(Payload(key));
+          groups_.push_back(std::move(key));
+        }
+      }
+    }
+    input_.reset();
+  }
+
+  std::unique_ptr<Operator> input_;
+  std::vector<std::size_t>  group_indices_;
+  const std::size_t         batch_size_;
+  Rows                      groups_;
+  memory::Reservation       payload_;
+  std::size_t               offset_;
+
+  RIEL_DISALLOW_ALL(HashAggregateOperator);
+};
+
+/**
+ * Groups an input already sorted on the group keys. Each group is emitted as
+ * soon as its key changes, so only the current key is held in memory.
+ */
+class RIEL_EXPORT StreamingAggregateOperator : public Operator {
+public:
+  StreamingAggregateOperator(std::unique_ptr<Operator> &&input,
+                             std::vector<std::size_t>    group_indices)
+      : Operator{"StreamingAggregate"}, input_{std::move(input)},
+        group_indices_{std::move(group_indices)}, current_{} {}
+
+  ~StreamingAggregateOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    std::vector<Column> columns(group_indices_.size());
+
+    Batch input;
+    while (input_->Next(input)) {
+      for (std::size_t r = 0; r < input.size(); ++r) {
+        if (current_ && Matches(input, r)) { continue; }
+        if (current_) { Emit(columns); }
+
+        current_.emplace();
+        current_->reserve(group_indices_.size());
+        for (const auto index : group_indices_) {
+          current_->push_back(input.at(index, r));
+        }
+      }
+      if (!columns[0].empty()) {
+        batch = Batch{std::move(columns)};
+        return true;
+      }
+    }
+
+    if (!current_) { return false; }
+    Emit(columns);
+    batch = Batch{std::move(columns)};
+    return true;
+  }
+
+private:
+  bool Matches(const Batch &input, const std::size_t row_index) const {
+    for (std::size_t i = 0; i < group_indices_.size(); ++i) {
+      if ((*current_)[i] != input.at(group_indices_[i], row_index)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Emit(std::vector<Column> &columns) {
+    for (std::size_t c = 0; c < columns.size(); ++c) {
+      columns[c].push_back(std::move((*current_)[c]));
+    }
+    current_.reset();
+  }
+
+  std::unique_ptr<Operator> input_;
+  std::vector<std::size_t>  group_indices_;
+  std::optional<Row>        current_;
+
+  RIEL_DISALLOW_ALL(StreamingAggregateOperator);
+};
+
+/**
+ * Inner equi-join indexing one input in a hash table and streaming the other
+ * through it. Build rows are hashed on one thread per partition, split by key
+ * hash into partitions indexed each by its own thread, and their keys fill
+ * the Bloom filter pushed into the probe side scans. Probe batches are joined
+ * as many at a time as there are partitions, each on its own thread, and come
+ * out in input order. Output rows are the left fields followed by the right
+ * ones, whichever input is built.
+ */
+class RIEL_EXPORT HashJoinOperator : public Operator {
+public:
+  HashJoinOperator(std::unique_ptr<Operator> &&  build,
+                   std::unique_ptr<Operator> &&  probe,
+                   std::vector<std::size_t>      build_keys,
+                   std::vector<std::size_t>      probe_keys,
+                   const bool                    build_left,
+                   const std::size_t             expected_rows,
+                   const std::size_t             partitions,
+                   std::shared_ptr<BloomFilter> &&bloom)
+      : Operator{"HashJoin"}, build_{std::move(build)},
+        probe_{std::move(probe)}, build_keys_{std::move(build_keys)},
+        probe_keys_{std::move(probe_keys)}, expected_rows_{expected_rows},
+        bloom_{std::move(bloom)}, built_{},
+        indexes_(partitions, Index{allocator<Index::value_type>()}),
+        ready_{}, pool_{}, build_left_{build_left} {}
+
+  ~HashJoinOperator() final;
+
+  std::size_t partitions() const noexcept { return indexes_.size(); }
+
+protected:
+  bool Produce(Batch &batch) final {
+    if (build_) { Build(); }
+    if (built_.empty()) {
+      pool_.reset();
+      return false;
+    }
+
+    while (ready_.empty()) {
+      std::vector<Batch> probes;
+      Batch              probe;
+      while (probes.size() < partitions() && probe_->Next(probe)) {
+        probes.push_back(std::move(probe));
+      }
+      if (probes.empty()) {
+        pool_.reset();
+        return false;
+      }
+
+      std::vector<Batch> joined(probes.size());
+      pool_->Run(probes.size(),
+                 [&](const std::size_t i) { Probe(probes[i], joined[i]); });
+      for (auto &output : joined) {
+        if (0 < output.size()) { ready_.push_back(std::move(output)); }
+      }
+    }
+
+    batch = std::move(ready_.front());
+    ready_.pop_front();
+    return true;
+  }
+
+private:
+  struct Position {
+    std::size_t batch;
+    std::size_t row;
+  };
+
+  struct Entry {
+    std::size_t hash;
+    Position    position;
+  };
+
+  using Entries = std::vector<Entry, memory::Allocator<Entry>>;
+  using Index   = std::unordered_multimap<
+      std::size_t,
+      Position,
+      std::hash<std::size_t>,
+      std::equal_to<std::size_t>,
+      memory::Allocator<std::pair<const std::size_t, Position>>>;
+
+  // Each thread hashes every partitions()-th build batch into its own share
+  // of every partition and its own Bloom filter, then each thread indexes
+  // one partition from all the shares. The threads stay for the probe.
+  void Build() {
+    Batch input;
+    while (build_->Next(input)) {
+      if (0 < input.size()) { built_.push_back(std::move(input)); }
+    }
+    build_.reset();
+
+    const std::size_t count = partitions();
+    pool_ = std::make_unique<threading::ThreadPool>(count - 1);
+
+    std::vector<std::vector<Entries>> shares(count);
+    for (auto &share : shares) {
+      share.resize(count);
+      for (auto &entries : share) {
+        entries.reserve(expected_rows_ / (count * count) + 1);
+      }
+    }
+    std::vector<BloomFilter> blooms(count - 1, *bloom_);
+
+    pool_->Run(count, [&](const std::size_t t) {
+      BloomFilter &bloom = 0 == t ? *bloom_ : blooms[t - 1];
+      for (std::size_t b = t; b < built_.size(); b += count) {
+        for (std::size_t r = 0; r < built_[b].size(); ++r) {
+          const std::size_t hash = KeyHash(built_[b], build_keys_, r);
+          bloom.Insert(hash);
+          shares[t][Partition(hash)].push_back({hash, {b, r}});
+        }
+      }
+    });
+    for (const auto &bloom : blooms) { bloom_->Merge(bloom); }
+
+    pool_->Run(count,
+               [&](const std::size_t p) { Populate(indexes_[p], shares, p); });
+  }
+
+  static void Populate(Index &                                  index,
+                       const std::vector<std::vector<Entries>> &shares,
+                       const std::size_t                        partition) {
+    RIEL_TRACE("HashJoinOperator::Populate");
+
+    std::size_t size = 0;
+    for (const auto &share : shares) { size += share[partition].size(); }
+    index.reserve(size);
+
+    for (const auto &share : shares) {
+      for (const auto &entry : share[partition]) {
+        index.emplace(entry.hash, entry.position);
+      }
+    }
+  }
+
+  bool Probe(const Batch &probe, Batch &batch) const {
+    RIEL_TRACE("HashJoinOperator::Probe");
+
+    const std::size_t   build_width = built_[0].width();
+    std::vector<Column> columns(build_width + probe.width());
+
+    const std::size_t build_offset = build_left_ ? 0 : probe.width();
+    const std::size_t probe_offset = build_left_ ? build_width : 0;
+
+    for (std::size_t r = 0; r < probe.size(); ++r) {
+      const std::size_t hash  = KeyHash(probe, probe_keys_, r);
+      const auto        range = indexes_[Partition(hash)].equal_range(hash);
+      for (auto it = range.first; range.second != it; ++it) {
+        const Batch &     build = built_[it->second.batch];
+        const std::size_t row   = it->second.row;
+        if (!Matches(build, row, probe, r)) { continue; }
+
+        for (std::size_t c = 0; c < build_width; ++c) {
+          columns[build_offset + c].push_back(build.at(c, row));
+        }
+        for (std::size_t c = 0; c < probe.width(); ++c) {
+          columns[probe_offset + c].push_back(probe.at(c, r));
+        }
+      }
+    }
+    if (columns[0].empty()) { return false; }
+
+    batch = Batch{std::move(columns)};
+    return true;
+  }
+
+  bool Matches(const Batch &     build,
+               const std::size_t build_row,
+               const Batch &     probe,
+               const std::size_t probe_row) const {
+    for (std::size_t i = 0; i < build_keys_.size(); ++i) {
+      if (build.at(build_keys_[i], build_row) !=
+          probe.at(probe_keys_[i], probe_row)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::size_t Partition(const std::size_t hash) const noexcept {
+    return MixHash(hash) % indexes_.size();
+  }
+
+  std::unique_ptr<Operator>              build_;
+  std::unique_ptr<Operator>              probe_;
+  const std::vector<std::size_t>         build_keys_;
+  const std::vector<std::size_t>         probe_keys_;
+  const std::size_t                      expected_rows_;
+  const std::shared_ptr<BloomFilter>     bloom_;
+  std::vector<Batch>                     built_;
+  std::vector<Index>                     indexes_;
+  std::deque<Batch>                      ready_;
+  std::unique_ptr<threading::ThreadPool> pool_;
+  const bool                             build_left_ : __SYSCALL_WORDSIZE;
+
+  RIEL_DISALLOW_ALL(HashJoinOperator);
+};
+
+// = = = = =
+// Sorting
+// = = = = =
+
+using SortKeys = std::vector<SortNode::Key>;
+
+/**
+ * Appends to `key` a byte string ordering as the sort keys of the
+ * `row_index`-th row of `batch`, so rows sort by plain byte comparison.
+ * Integers are big endian with the sign bit flipped, strings escape their
+ * zero bytes and end in two of them, and descending keys invert their bytes.
+ */
+inline void Normalize(const Batch &     batch,
+                      const SortKeys &  keys,
+                      const std::size_t row_index,
+                      std::string &     key) {
+  for (const auto &sort_key : keys) {
+    const std::size_t begin = key.size();
+    const Datum &     datum = batch.at(sort_key.index, row_index);
+
+    key.push_back(static_cast<char>(datum.index()));
+    if (const auto *integer = std::get_if<std::int64_t>(&datum)) {
+      const auto bits =
+          static_cast<std::uint64_t>(*integer) ^ (std::uint64_t{1} << 63);
+      for (int shift = 56; 0 <= shift; shift -= 8) {
+        key.push_back(static_cast<char>(bits >> shift));
+      }
+    } else {
+      for (const char c : std::get<std::string>(datum)) {
+        key.push_back(c);
+        if ('\0' == c) { key.push_back('\xff'); }
+      }
+      key.append(2, '\0');
+    }
+
+    if (Direction::DESCENDING == sort_key.direction) {
+      for (std::size_t i = begin; i < key.size(); ++i) {
+        key[i] = static_cast<char>(~key[i]);
+      }
+    }
+  }
+}
+
+/**
+ * A row to sort: its normalized key and where it lives among the buffered
+ * input batches.
+ */
+struct RIEL_EXPORT SortEntry {
+  std::string key;
+  std::size_t batch;
+  std::size_t row;
+
+  bool operator<(const SortEntry &other) const noexcept {
+    return key < other.key;
+  }
+};
+
+using SortEntries = std::vector<SortEntry, memory::Allocator<SortEntry>>;
+
+/**
+ * Most significant byte first radix sort of `entries[begin, end)` on their
+ * keys from byte `depth`, distributing through the same range of `buffer`.
+ * Small ranges fall back to comparison sorting.
+ */
+inline void RadixSort(SortEntries &     entries,
+                      SortEntries &     buffer,
+                      const std::size_t begin,
+                      const std::size_t end,
+                      const std::size_t depth) {
+  static constexpr std::size_t kCutoff = 64;
+
+  if (end - begin <= kCutoff) {
+    std::sort(entries.begin() + static_cast<std::ptrdiff_t>(begin),
+              entries.begin() + static_cast<std::ptrdiff_t>(end),
+              [depth](const SortEntry &left, const SortEntry &right) {
+                return 0 > left.key.compare(
+                               depth, std::string::npos, right.key, depth);
+              });
+    return;
+  }
+
+  // Bucket 0 holds the keys ending before `depth`, all equal by now.
+  const auto bucket = [depth](const std::string &key) -> std::size_t {
+    return key.size() <= depth ? 0
+                               : 1 + static_cast<unsigned char>(key[depth]);
+  };
+
+  std::size_t starts[258] = {};
+  for (std::size_t i = begin; i < end; ++i) {
+    ++starts[bucket(entries[i].key) + 1];
+  }
+  starts[0] = begin;
+  std::partial_sum(std::begin(starts), std::end(starts), std::begin(starts));
+
+  std::size_t offsets[257];
+  std::copy(std::begin(starts), std::begin(starts) + 257, offsets);
+  for (std::size_t i = begin; i < end; ++i) {
+    buffer[offsets[bucket(entries[i].key)]++] = std::move(entries[i]);
+  }
+  std::move(buffer.begin() + static_cast<std::ptrdiff_t>(begin),
+            buffer.begin() + static_cast<std::ptrdiff_t>(end),
+            entries.begin() + static_cast<std::ptrdiff_t>(begin));
+
+  for (std::size_t b = 1; b < 257; ++b) {
+    if (1 < starts[b + 1] - starts[b]) {
+      RadixSort(entries, buffer, starts[b], starts[b + 1], depth + 1);
+    }
+  }
+}
+
+/**
+ * Sorts its whole input. The buffered rows are split in runs, one per
+ * thread, whose normalized keys are radix sorted in parallel; batches are
+ * then emitted by a k-way merge of the runs. Ties keep their input order.
+ */
+class RIEL_EXPORT SortOperator : public Operator {
+public:
+  SortOperator(std::unique_ptr<Operator> &&input,
+               SortKeys                    keys,
+               const std::size_t           batch_size,
+               const std::size_t           runs)
+      : Operator{"Sort"}, input_{std::move(input)}, keys_{std::move(keys)},
+        batch_size_{batch_size}, runs_{runs}, inputs_{},
+        entries_{allocator<SortEntry>()}, payload_{reservation()}, cursors_{},
+        heap_{} {}
+
+  ~SortOperator() final;
+
+  std::size_t runs() const noexcept { return runs_; }
+
+protected:
+  bool Produce(Batch &batch) final {
+    if (input_) { Sort(); }
+    if (heap_.empty()) { return false; }
+
+    std::vector<Column> columns(inputs_[0].width());
+    for (std::size_t r = 0; r < batch_size_ && !heap_.empty(); ++r) {
+      std::pop_heap(heap_.begin(), heap_.end(), Later{entries_, cursors_});
+      const std::size_t run   = heap_.back();
+      const SortEntry & entry = entries_[cursors_[run].first++];
+      for (std::size_t c = 0; c < columns.size(); ++c) {
+        columns[c].push_back(inputs_[entry.batch].at(c, entry.row));
+      }
+
+      heap_.pop_back();
+      if (cursors_[run].first < cursors_[run].second) {
+        heap_.push_back(run);
+        std::push_heap(heap_.begin(), heap_.end(), Later{entries_, cursors_});
+      }
+    }
+
+    batch = Batch{std::move(columns)};
+    return true;
+  }
+
+private:
+  // Orders the heap of runs on the key at their cursor, smallest on top.
+  // First and last entries of a run, the first advancing while merging.
+  using Run = std::pair<std::size_t, std::size_t>;
+
+  struct Later {
+    const SortEntries &     entries;
+    const std::vector<Run> &cursors;
+
+    bool operator()(const std::size_t left, const std::size_t right) const {
+      return entries[cursors[right].first] < entries[cursors[left].first];
+    }
+  };
+
+  void Sort() {
+    Batch input;
+    std::size_t rows = 0;
+    while (input_->Next(input)) {
+      rows += input.size();
+      if (0 < input.size()) { inputs_.push_back(std::move(input)); }
+    }
+    input_.reset();
+
+    entries_.resize(rows);
+    SortEntries buffer(rows);
+
+    const std::size_t runs = std::max<std::size_t>(std::min(runs_, rows), 1);
+    const std::size_t size = (rows + runs - 1) / runs;
+    for (std::size_t begin = 0; begin < rows; begin += size) {
+      cursors_.emplace_back(begin, std::min(begin + size, rows));
+    }
+
+    threading::ThreadPool{std::max<std::size_t>(cursors_.size(), 1) - 1}.Run(
+        cursors_.size(),
+        [&](const std::size_t run) { SortRun(cursors_[run], buffer); });
+
+    for (std::size_t run = 0; run < cursors_.size(); ++run) {
+      heap_.push_back(run);
+    }
+    std::make_heap(heap_.begin(), heap_.end(), Later{entries_, cursors_});
+  }
+
+  // Normalizes the keys of the rows in `run` and radix sorts them. Each key
+  // ends in the row sequence number, so ties keep their input order.
+  void SortRun(const Run &run, SortEntries &buffer) {
+    RIEL_TRACE("SortOperator::SortRun");
+
+    std::size_t bytes = 0;
+    std::size_t b     = 0;
+    std::size_t r = run.first;
+    while (r >= inputs_[b].size()) { r -= inputs_[b++].size(); }
+
+    for (std::size_t i = run.first; i < run.second; ++i) {
+      SortEntry &entry = entries_[i];
+      Normalize(inputs_[b], keys_, r, entry.key);
+      for (int shift = 56; 0 <= shift; shift -= 8) {
+        entry.key.push_back(static_cast<char>(i >> shift));
+      }
+      entry.batch = b;
+      entry.row   = r;
+      bytes += memory::Payload(entry.key);
+
+      if (++r == inputs_[b].size()) {
+        ++b;
+        r = 0;
+      }
+    }
+    payload_.Grow(bytes);
+    RadixSort(entries_, buffer, run.first, run.second, 0);
+  }
+
+  std::unique_ptr<Operator> input_;
+  const SortKeys            keys_;
+  const std::size_t         batch_size_;
+  const std::size_t         runs_;
+  std::vector<Batch>        inputs_;
+  SortEntries               entries_;
+  memory::Reservation       payload_;
+  std::vector<Run>          cursors_;
+  std::vector<std::size_t>  heap_;
+
+  RIEL_DISALLOW_ALL(SortOperator);
+};
+
+/**
+ * Keeps the first `fetch` rows in sort order. A max-heap on normalized keys
+ * holds the best rows seen so far, so memory stays proportional to `fetch`
+ * whatever the input size; rows are copied out as they enter the heap.
+ */
+class RIEL_EXPORT TopNOperator : public Operator {
+public:
+  TopNOperator(std::unique_ptr<Operator> &&input,
+               SortKeys                    keys,
+               const std::size_t           fetch,
+               const std::size_t           batch_size)
+      : Operator{"TopN"}, input_{std::move(input)}, keys_{std::move(keys)},
+        fetch_{fetch}, batch_size_{batch_size},
+        candidates_{allocator<Candidate>()}, payload_{reservation()},
+        offset_{0} {}
+
+  ~TopNOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    if (input_) { Select(); }
+    if (offset_ >= candidates_.size()) { return false; }
+
+    const std::size_t end = std::min(offset_ + batch_size_, candidates_.size());
+
+    std::vector<Column> columns(candidates_[offset_].row.size());
+    for (; offset_ < end; ++offset_) {
+      payload_.Shrink(candidates_[offset_].Payload());
+      for (std::size_t c = 0; c < columns.size(); ++c) {
+        columns[c].push_back(std::move(candidates_[offset_].row[c]));
+      }
+    }
+
+    batch = Batch{std::move(columns)};
+    return true;
+  }
+
+private:
+  struct Candidate {
+    std::string key;
+    Row         row;
+
+    bool operator<(const Candidate &other) const noexcept {
+      return key < other.key;
+    }
+
+    std::size_t Payload() const noexcept {
+      return memory::Payload(key) + execution::Payload(row);
+    }
+  };
+
+  using Candidates = std::vector<Candidate, memory::Allocator<Candidate>>;
+
+  void Select() {
+    std::size_t sequence = 0;
+    std::string key;
+    Batch       input;
+    while (0 < fetch_ && input_->Next(input)) {
+      for (std::size_t r = 0; r < input.size(); ++r, ++sequence) {
+        key.clear();
+        Normalize(input, keys_, r, key);
+        for (int shift = 56; 0 <= shift; shift -= 8) {
+          key.push_back(static_cast<char>(sequence >> shift));
+        }
+
+        if (candidates_.size() == fetch_) {
+          if (!(key < candidates_.front().key)) { continue; }
+          std::pop_heap(candidates_.begin(), candidates_.end());
+          payload_.Shrink(candidates_.back().Payload());
+          candidates_.pop_back();
+        }
+        candidates_.push_back({key, input.row(r)});
+        payload_.Grow(candidates_.back().Payload());
+        std::push_heap(candidates_.begin(), candidates_.end());
+      }
+    }
+    input_.reset();
+
+    std::sort_heap(candidates_.begin(), candidates_.end());
+  }
+
+  std::unique_ptr<Operator> input_;
+  const SortKeys            keys_;
+  const std::size_t         fetch_;
+  const std::size_t         batch_size_;
+  Candidates                candidates_;
+  memory::Reservation       payload_;
+  std::size_t               offset_;
+
+  RIEL_DISALLOW_ALL(TopNOperator);
+};
+
+/**
+ * Passes through the first `fetch` rows of its input and stops pulling it.
+ */
+class RIEL_EXPORT LimitOperator : public Operator {
+public:
+  LimitOperator(std::unique_ptr<Operator> &&input, const std::size_t fetch)
+      : Operator{"Limit"}, input_{std::move(input)}, remaining_{fetch} {}
+
+  ~LimitOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    if (0 == remaining_ || !input_->Next(batch)) { return false; }
+
+    if (batch.size() > remaining_) { batch = batch.Slice(0, remaining_); }
+    remaining_ -= batch.size();
+    return true;
+  }
+
+private:
+  std::unique_ptr<Operator> input_;
+  std::size_t               remaining_;
+
+  RIEL_DISALLOW_ALL(LimitOperator);
+};
+
+// = = = = = = =
+// Result cache
+// = = = = = = =
+
+/**
+ * Batches produced by subplans, keyed by the canonical text of the subplan
+ * and checked against the versions of the tables it read. Least recently
+ * used entries are evicted to stay within the byte budget.
+ */
+class RIEL_EXPORT ResultCache {
+public:
+  using Batches  = std::vector<Batch>;
+  using Versions = std::map<std::vector<std::string>, std::size_t>;
+
+  explicit ResultCache(const std::size_t budget)
+      : budget_{budget}, bytes_{0}, hits_{0}, misses_{0}, mutex_{},
+        entries_{}, index_{} {}
+
+  ~ResultCache();
+
+  /**
+   * Cached batches of `plan`, or null when missing or computed from older
+   * table versions.
+   */
+  std::shared_ptr<const Batches> Find(const std::string &plan,
+                                      const Versions &   versions) {
+    const std::lock_guard<std::mutex> lock{mutex_};
+
+    const auto it = index_.find(plan);
+    if (index_.cend() == it) {
+      ++misses_;
+      return nullptr;
+    }
+    if (versions != it->second->versions) {
+      Erase(it->second);
+      ++misses_;
+      return nullptr;
+    }
+
+    entries_.splice(entries_.begin(), entries_, it->second);
+    ++hits_;
+    return it->second->batches;
+  }
+
+  void Insert(const std::string &plan, Versions &&versions, Batches &&batches) {
+    const std::size_t bytes = plan.size() + Bytes(batches);
+    if (bytes > budget_) { return; }
+
+    const std::lock_guard<std::mutex> lock{mutex_};
+
+    const auto it = index_.find(plan);
+    if (index_.cend() != it) { Erase(it->second); }
+
+    entries_.push_front(
+        {plan,
+         std::move(versions),
+         std::make_shared<const Batches>(std::move(batches)),
+         bytes});
+    index_.emplace(plan, entries_.begin());
+    bytes_ += bytes;
+
+    while (bytes_ > budget_) { Erase(std::prev(entries_.end())); }
+  }
+
+  /** Drops every entry that read the table at `path`. */
+  void Invalidate(const std::vector<std::string> &path) {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    for (auto it = entries_.begin(); entries_.end() != it;) {
+      const auto current = it++;
+      if (current->versions.count(path)) { Erase(current); }
+    }
+  }
+
+  std::size_t budget() const noexcept { return budget_; }
+
+  std::size_t bytes() const noexcept { return bytes_; }
+
+  std::size_t hits() const noexcept { return hits_; }
+
+  std::size_t misses() const noexcept { return misses_; }
+
+  /** Approximate footprint of `column`, strings included. */
+  static std::size_t Bytes(const Column &column) {
+    return column.capacity() * sizeof(Datum) + Payload(column);
+  }
+
+  /**
+   * Approximate footprint of the columns `batches` keep alive. Batches share
+   * whole columns however few rows they hold, so each column counts once and
+   * in full.
+   */
+  static std::size_t Bytes(const Batches &batches) {
+    std::unordered_set<const Column *> counted;
+    std::size_t                        bytes = 0;
+    for (const auto &batch : batches) {
+      for (std::size_t c = 0; c < batch.width(); ++c) {
+        if (counted.insert(batch.column(c).get()).second) {
+          bytes += Bytes(*batch.column(c));
+        }
+      }
+    }
+    return bytes;
+  }
+
+private:
+  struct Entry {
+    std::string                    plan;
+    Versions                       versions;
+    std::shared_ptr<const Batches> batches;
+    std::size_t                    bytes;
+  };
+
+  using Entries = std::list<Entry>;
+
+  void Erase(const Entries::iterator it) {
+    bytes_ -= it->bytes;
+    index_.erase(it->plan);
+    entries_.erase(it);
+  }
+
+  const std::size_t                                  budget_;
+  std::atomic<std::size_t>                           bytes_;
+  std::atomic<std::size_t>                           hits_;
+  std::atomic<std::size_t>                           misses_;
+  std::mutex                                         mutex_;
+  Entries                                            entries_;
+  std::unordered_map<std::string, Entries::iterator> index_;
+
+  RIEL_DISALLOW_ALL(ResultCache);
+};
+
+/**
+ * Replays the batches of a cache entry.
+ */
+class RIEL_EXPORT CachedOperator : public Operator {
+public:
+  explicit CachedOperator(std::shared_ptr<const ResultCache::Batches> batches)
+      : Operator{"Cached"}, batches_{std::move(batches)}, offset_{0} {}
+
+  ~CachedOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    if (offset_ >= batches_->size()) { return false; }
+    batch = (*batches_)[offset_++];
+    return true;
+  }
+
+private:
+  const std::shared_ptr<const ResultCache::Batches> batches_;
+  std::size_t                                       offset_;
+
+  RIEL_DISALLOW_ALL(CachedOperator);
+};
+
+/**
+ * Passes batches through and caches them once the input is exhausted.
+ * Recording stops when the batches outgrow the cache budget.
+ */
+class RIEL_EXPORT CachingOperator : public Operator {
+public:
+  CachingOperator(std::unique_ptr<Operator> &&input,
+                  ResultCache &               cache,
+                  std::string                 plan,
+                  ResultCache::Versions &&    versions,
+                  const std::size_t           budget)
+      : Operator{"Caching"}, input_{std::move(input)}, cache_{cache},
+        plan_{std::move(plan)}, versions_{std::move(versions)}, batches_{},
+        counted_{}, budget_{budget}, bytes_{0}, recording_{true} {}
+
+  ~CachingOperator() final;
+
+protected:
+  bool Produce(Batch &batch) final {
+    if (!input_->Next(batch)) {
+      if (recording_) {
+        recording_ = false;
+        cache_.Insert(plan_, std::move(versions_), std::move(batches_));
+      }
+      return false;
+    }
+
+    if (recording_) {
+      for (std::size_t c = 0; c < batch.width(); ++c) {
+        if (counted_.insert(batch.column(c).get()).second) {
+          bytes_ += ResultCache::Bytes(*batch.column(c));
+        }
+      }
+      if (bytes_ > budget_) {
+        recording_ = false;
+        batches_.clear();
+        counted_.clear();
+      } else {
+        batches_.push_back(batch);
+      }
+    }
+    return true;
+  }
+
+private:
+  std::unique_ptr<Operator>          input_;
+  ResultCache &                      cache_;
+  const std::string                  plan_;
+  ResultCache::Versions              versions_;
+  ResultCache::Batches               batches_;
+  std::unordered_set<const Column *> counted_;
+  const std::size_t                  budget_;
+  std::size_t                        bytes_;
+  bool                               recording_;
+
+  RIEL_DISALLOW_ALL(CachingOperator);
+};
+
+// = = = = = =
+// Execution
+// = = = = = =
+
+/**
+ * Compiles a plan tree into its operator tree. With a result cache, the
+ * outermost Project and Aggregate subtrees are replayed from it when their
+ * tables are unchanged and recorded into it otherwise; while the executor
+ * lives, registering a table drops the entries that read it. Hash joins and
+ * sorts use up to `threads` threads, all the hardware ones by default. A
+ * source may produce whole subtrees elsewhere, the executor compiling only
+ * the nodes above them.
+ */
+class RIEL_EXPORT Executor : public Visitor {
+public:
+  static constexpr std::size_t kDefaultBatchSize = 1024;
+
+  /**
+   * Operator producing the subtree rooted at the node, or null to compile it
+   * here. Predicates pushed down to such a subtree are evaluated above it.
+   */
+  using Source = std::function<std::unique_ptr<Operator>(const Node &)>;
+
+  /** Estimated rows worth one more thread to hash join builds and sorts. */
+  static constexpr std::size_t kPartitionRows = 4096;
+
+  explicit Executor(const Catalog &   catalog,
+                    const std::size_t batch_size = kDefaultBatchSize,
+                    ResultCache *     cache      = nullptr,
+                    const std::size_t threads    = 0,
+                    Source            source     = nullptr)
+      : catalog_{catalog}, properties_{catalog}, batch_size_{batch_size},
+        cache_{cache},
+        threads_{0 == threads ? std::max<std::size_t>(
+                                    std::thread::hardware_concurrency(), 1)
+                              : threads},
+        source_{std::move(source)},
+        listener_{nullptr == cache ? 0
+                                   : catalog.Listen([cache](const auto &path) {
+                                       cache->Invalidate(path);
+                                     })},
+        caching_{false}, pushed_{}, filters_{}, compiled_{} {}
+
+  ~Executor() final;
+
+  /**
+   * Operator tree of the plan rooted at `node`. Properties derived for
+   * earlier plans are dropped first. Compiling keeps its state in the
+   * executor, so it is not reentrant: one plan at a time per executor.
+   */
+  std::unique_ptr<Operator> Compile(const Node &node) const {
+    properties_.Reset();
+    caching_ = false;
+    pushed_.clear();
+    filters_.clear();
+    return CompileNode(node);
+  }
+
+  const PropertiesDeriver &properties() const noexcept { return properties_; }
+
+  void Visit(const ScanNode &node) const final {
+    compiled_ = std::make_unique<ScanOperator>(catalog_.Find(node.path()),
+                                               batch_size_,
+                                               std::move(pushed_),
+                                               std::move(filters_));
+    pushed_.clear();
+    filters_.clear();
+  }
+
+  void Visit(const UnionNode &node) const final {
+    const Predicates     pushed  = std::move(pushed_);
+    const RuntimeFilters filters = std::move(filters_);
+
+    std::vector<std::unique_ptr<Operator>> inputs;
+    for (std::size_t i = 0; i < node.children().size(); ++i) {
+      pushed_  = pushed;
+      filters_ = filters;
+      inputs.push_back(CompileNode(*node.children()[i]));
+    }
+    compiled_ = std::make_unique<UnionOperator>(std::move(inputs), node.all());
+  }
+
+  void Visit(const AggregateNode &node) const final {
+    const auto &groups = node.group_indices();
+    for (auto &predicate : pushed_) {
+      predicate.index = groups[Checked(node, predicate.index, groups.size())];
+    }
+    for (auto &filter : filters_) {
+      for (auto &index : filter.indices) {
+        index = groups[Checked(node, index, groups.size())];
+      }
+    }
+
+    const Node &child = *node.children()[0];
+    auto        input = CompileNode(child);
+
+    if (IsSortedOn(properties_.Derive(child).collation,
+                   node.group_indices())) {
+      compiled_ = std::make_unique<StreamingAggregateOperator>(
+          std::move(input), node.group_indices());
+    } else {
+      compiled_ = std::make_unique<HashAggregateOperator>(
+          std::move(input), node.group_indices(), batch_size_);
+    }
+  }
+
+  void Visit(const ProjectNode &node) const final {
+    const auto &pairs = node.pairs();
+    for (auto &predicate : pushed_) {
+      predicate.index =
+          pairs[Checked(node, predicate.index, pairs.size())].second;
+    }
+    for (auto &filter : filters_) {
+      for (auto &index : filter.indices) {
+        index = pairs[Checked(node, index, pairs.size())].second;
+      }
+    }
+
+    auto input = CompileNode(*node.children()[0]);
+
+    std::vector<std::size_t> indices;
+    for (const auto &pair : node.pairs()) { indices.push_back(pair.second); }
+
+    compiled_ =
+        std::make_unique<ProjectOperator>(std::move(input), std::move(indices));
+  }
+
+  /**
+   * Filters compile to nothing: their predicates are pushed down through
+   * projections, unions, joins and aggregates (whose outputs are all group
+   * keys) into the scans below.
+   */
+  void Visit(const FilterNode &node) const final {
+    const Node &      child = *node.children()[0];
+    const std::size_t width = properties_.Derive(child).width;
+    for (const auto &conjunct : node.conjuncts()) {
+      Checked(node, conjunct.index, width);
+    }
+
+    pushed_.insert(
+        pushed_.end(), node.conjuncts().cbegin(), node.conjuncts().cend());
+    compiled_ = CompileNode(child);
+  }
+
+  /**
+   * Builds the input estimated smaller and pushes a Bloom filter over its keys
+   * into the scans of the other. Pushed down predicates and runtime filters go
+   * to the input holding their columns; filters spanning both are dropped.
+   */
+  void Visit(const JoinNode &node) const final {
+    const Node &      left       = *node.children()[0];
+    const Node &      right      = *node.children()[1];
+    const auto &      left_stats = properties_.Derive(left);
+    const std::size_t width      = left_stats.width;
+
+    std::vector<std::size_t> left_keys;
+    std::vector<std::size_t> right_keys;
+    for (const auto &key : node.keys()) {
+      const auto bounds = std::minmax(key.first, key.second);
+      if (bounds.first >= width || bounds.second < width) {
+        throw std::runtime_error("Join condition must compare both inputs: " +
+                                 static_cast<std::string>(node));
+      }
+      left_keys.push_back(bounds.first);
+      right_keys.push_back(bounds.second - width);
+    }
+
+    Predicates     left_pushed;
+    Predicates     right_pushed;
+    RuntimeFilters left_filters;
+    RuntimeFilters right_filters;
+    for (auto &predicate : pushed_) {
+      if (predicate.index < width) {
+        left_pushed.push_back(std::move(predicate));
+      } else {
+        predicate.index -= width;
+        right_pushed.push_back(std::move(predicate));
+      }
+    }
+    for (auto &filter : filters_) {
+      const auto &indices = filter.indices;
+      if (std::all_of(indices.cbegin(), indices.cend(), [width](auto index) {
+            return index < width;
+          })) {
+        left_filters.push_back(std::move(filter));
+      } else if (std::all_of(
+                     indices.cbegin(), indices.cend(), [width](auto index) {
+                       return index >= width;
+                     })) {
+        for (auto &index : filter.indices) { index -= width; }
+        right_filters.push_back(std::move(filter));
+      }
+    }
+    pushed_.clear();
+    filters_.clear();
+
+    const auto &right_stats = properties_.Derive(right);
+    const bool  build_left =
+        PropertiesDeriver::BuildsLeft(left_stats, right_stats);
+    const std::size_t expected_rows =
+        build_left ? left_stats.rows : right_stats.rows;
+
+    auto bloom = std::make_shared<BloomFilter>(expected_rows);
+    if (build_left) {
+      right_filters.push_back({bloom, right_keys});
+    } else {
+      left_filters.push_back({bloom, left_keys});
+    }
+
+    pushed_       = std::move(left_pushed);
+    filters_      = std::move(left_filters);
+    auto left_op  = CompileNode(left);
+    pushed_       = std::move(right_pushed);
+    filters_      = std::move(right_filters);
+    auto right_op = CompileNode(right);
+
+    const std::size_t partitions =
+        std::min(threads_, expected_rows / kPartitionRows + 1);
+    if (build_left) {
+      compiled_ = std::make_unique<HashJoinOperator>(std::move(left_op),
+                                                     std::move(right_op),
+                                                     std::move(left_keys),
+                                                     std::move(right_keys),
+                                                     true,
+                                                     expected_rows,
+                                                     partitions,
+                                                     std::move(bloom));
+    } else {
+      compiled_ = std::make_unique<HashJoinOperator>(std::move(right_op),
+                                                     std::move(left_op),
+                                                     std::move(right_keys),
+                                                     std::move(left_keys),
+                                                     false,
+                                                     expected_rows,
+                                                     partitions,
+                                                     std::move(bloom));
+    }
+  }
+
+  /**
+   * Sorts over an input already ordered on their keys only limit it, and
+   * fetching sorts keep a Top-N heap instead of sorting everything. Pushed
+   * down predicates would change which rows get fetched, so they are
+   * evaluated above a fetch; runtime filters are dropped there.
+   */
+  void Visit(const SortNode &node) const final {
+    const Node &    child = *node.children()[0];
+    const SortKeys &keys  = node.keys();
+    const auto &    fetch = node.fetch();
+
+    Predicates pushed;
+    if (fetch) {
+      pushed = std::move(pushed_);
+      pushed_.clear();
+      filters_.clear();
+    }
+
+    auto        input            = CompileNode(child);
+    const auto &input_properties = properties_.Derive(child);
+
+    if (IsOrdered(input_properties.collation, keys)) {
+      compiled_ = fetch ? std::make_unique<LimitOperator>(std::move(input),
+                                                          *fetch)
+                        : std::move(input);
+    } else if (fetch) {
+      compiled_ = std::make_unique<TopNOperator>(
+          std::move(input), keys, *fetch, batch_size_);
+    } else {
+      compiled_ = std::make_unique<SortOperator>(
+          std::move(input),
+          keys,
+          batch_size_,
+          std::min(threads_, input_properties.rows / kPartitionRows + 1));
+    }
+
+    if (!pushed.empty()) {
+      compiled_ = std::make_unique<FilterOperator>(std::move(compiled_),
+                                                   std::move(pushed));
+    }
+  }
+
+  /** Whether rows sorted by `collation` are already ordered by `keys`. */
+  static bool IsOrdered(const Collation &collation, const SortKeys &keys) {
+    if (keys.size() > collation.size()) { return false; }
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      if (Direction::ASCENDING != keys[i].direction ||
+          collation[i] != keys[i].index) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  std::unique_ptr<Operator> CompileNode(const Node &node) const {
+    if (source_) {
+      if (auto op = source_(node)) {
+        filters_.clear();
+        if (pushed_.empty()) { return op; }
+
+        auto filtered =
+            std::make_unique<FilterOperator>(std::move(op), std::move(pushed_));
+        pushed_.clear();
+        return filtered;
+      }
+    }
+    if (nullptr != cache_ && !caching_ && pushed_.empty() &&
+        filters_.empty() &&
+        (Type::PROJECT == node.id() || Type::AGGREGATE == node.id())) {
+      return CompileCached(node);
+    }
+    node.Accept(*this);
+    return std::move(compiled_);
+  }
+
+  std::unique_ptr<Operator> CompileCached(const Node &node) const {
+    const std::string     plan = Format(node);
+    ResultCache::Versions versions;
+    CollectVersions(node, versions);
+
+    if (auto batches = cache_->Find(plan, versions)) {
+      return std::make_unique<CachedOperator>(std::move(batches));
+    }
+
+    // Only the outermost subtree is recorded; the ones below it would cache
+    // rows that the outer entry already replays.
+    caching_ = true;
+    node.Accept(*this);
+    caching_ = false;
+    return std::make_unique<CachingOperator>(std::move(compiled_),
+                                             *cache_,
+                                             plan,
+                                             std::move(versions),
+                                             cache_->budget());
+  }
+
+  /** `index` when below `width`, else a plan error naming `node`. */
+  template <class NodeT>
+  static std::size_t Checked(const NodeT &     node,
+                             const std::size_t index,
+                             const std::size_t width) {
+    if (index >= width) {
+      throw std::runtime_error("Column $" + std::to_string(index) +
+                               " out of range: " +
+                               static_cast<std::string>(node));
+    }
+    return index;
+  }
+
+  void CollectVersions(const Node &           node,
+                       ResultCache::Versions &versions) const {
+    if (const auto *scan = dynamic_cast<const ScanNode *>(&node)) {
+      versions[scan->path()] = catalog_.version(scan->path());
+    }
+    for (std::size_t i = 0; i < node.children().size(); ++i) {
+      CollectVersions(*node.children()[i], versions);
+    }
+  }
+
+  const Catalog &                   catalog_;
+  const PropertiesDeriver           properties_;
+  const std::size_t                 batch_size_;
+  ResultCache *const                cache_;
+  const std::size_t                 threads_;
+  const Source                      source_;
+  const std::size_t                 listener_;
+  mutable bool                      caching_;
+  mutable Predicates                pushed_;
+  mutable RuntimeFilters            filters_;
+  mutable std::unique_ptr<Operator> compiled_;
+
+  RIEL_DISALLOW_ALL(Executor);
+};
+
+/**
+ * Drains `op` into rows, for callers that need whole rows at the end of a
+ * plan. Operators pass batches of shared columns instead; only the ones
+ * keying on rows (distinct unions and aggregates) build rows internally.
+ */
+inline std::vector<Row> Materialize(Operator &op) {
+  std::vector<Row> rows;
+  Batch            batch;
+  while (op.Next(batch)) {
+    for (std::size_t r = 0; r < batch.size(); ++r) {
+      rows.push_back(batch.row(r));
+    }
+  }
+  return rows;
+}
+
+/**
+ * Hands out the batches of an operator tree while a producer thread keeps
+ * executing it ahead of the consumer. At most `capacity` batches are queued;
+ * the producer blocks once the queue is full and stops when the cursor is
+ * cancelled or destroyed. The catalog read by the operators must outlive it.
+ */
+class RIEL_EXPORT Cursor {
+public:
+  static constexpr std::size_t kDefaultCapacity = 4;
+
+  explicit Cursor(std::unique_ptr<Operator> &&root,
+                  const std::size_t batch_size = Executor::kDefaultBatchSize,
+                  const std::size_t capacity   = kDefaultCapacity)
+      : root_{std::move(root)},
+        tracker_{memory::Scope::Current().shared_from_this()},
+        batch_size_{batch_size}, capacity_{capacity}, mutex_{}, not_empty_{},
+        not_full_{}, queue_{}, error_{}, state_{RUNNING}, producer_{} {
+    if (0 == batch_size_) {
+      throw std::invalid_argument("Cursor batch size must not be 0");
+    }
+    if (0 == capacity_) {
+      throw std::invalid_argument("Cursor capacity must not be 0");
+    }
+    producer_ = std::thread{&Cursor::Produce, this};
+  }
+
+  ~Cursor();
+
+  /**
+   * Waits for the next batch of at most `batch_size` rows. Returns false once
+   * exhausted or cancelled, and rethrows any error raised by the operators.
+   */
+  bool next_batch(Batch &batch) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    not_empty_.wait(lock,
+                    [this] { return !queue_.empty() || RUNNING != state_; });
+
+    if (!queue_.empty()) {
+      batch = std::move(queue_.front());
+      queue_.pop_front();
+      not_full_.notify_one();
+      return true;
+    }
+    if (error_) { std::rethrow_exception(std::exchange(error_, nullptr)); }
+    return false;
+  }
+
+  /** Stops the producer and drops the queued batches. */
+  void Cancel() {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    state_ = CANCELLED;
+    queue_.clear();
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+private:
+  enum State : std::size_t { RUNNING, FINISHED, CANCELLED };
+
+  void Produce() {
+    const memory::Scope scope{*tracker_};
+    try {
+      Batch batch;
+      while (root_->Next(batch)) {
+        for (std::size_t offset = 0; offset < batch.size();
+             offset += batch_size_) {
+          const auto length = std::min(batch_size_, batch.size() - offset);
+          if (!Push(batch.Slice(offset, length))) { return; }
+        }
+      }
+    } catch (...) {
+      const std::lock_guard<std::mutex> lock{mutex_};
+      error_ = std::current_exception();
+    }
+
+    const std::lock_guard<std::mutex> lock{mutex_};
+    if (RUNNING == state_) { state_ = FINISHED; }
+    not_empty_.notify_all();
+  }
+
+  bool Push(Batch &&batch) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    not_full_.wait(lock, [this] {
+      return queue_.size() < capacity_ || CANCELLED == state_;
+    });
+    if (CANCELLED == state_) { return false; }
+
+    queue_.push_back(std::move(batch));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  const std::unique_ptr<Operator>        root_;
+  const std::shared_ptr<memory::Tracker> tracker_;
+  const std::size_t                      batch_size_;
+  const std::size_t                      capacity_;
+  std::mutex                             mutex_;
+  std::condition_variable                not_empty_;
+  std::condition_variable                not_full_;
+  std::deque<Batch>                      queue_;
+  std::exception_ptr                     error_;
+  State                                  state_;
+  std::thread                            producer_;
+
+  RIEL_DISALLOW_ALL(Cursor);
+};
+
+}  // namespace execution
+}  // namespace riel
+
+#endif
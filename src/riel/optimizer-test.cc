@@ -0,0 +1,168 @@
+#include <riel/optimizer.h>
+
+#include <gtest/gtest.h>
+
+using riel::execution::Column;
+using riel::execution::Datum;
+using riel::execution::Row;
+using riel::optimizer::Physical;
+using riel::persistent::Plan;
+
+class MemoTest : public ::testing::Test {
+protected:
+  MemoTest() : catalog{} {
+    std::vector<Column> national(3);
+    for (std::int64_t i = 0; i < 1000; ++i) {
+      national[0].emplace_back("S" + std::to_string(i / 100));
+      national[1].emplace_back("N" + std::to_string(i / 10 % 10));
+      national[2].emplace_back(i);
+    }
+    catalog.Register({"RECORDS", "SALES", "NATIONAL"},
+                     std::make_shared<riel::execution::Table>(
+                         std::move(national),
+                         riel::execution::Collation{0, 1}));
+
+    std::vector<Column> international(3);
+    for (std::int64_t i = 0; i < 100; ++i) {
+      international[0].emplace_back("S" + std::to_string(i * 7 % 10));
+      international[1].emplace_back("N" + std::to_string(i * 3 % 10));
+      international[2].emplace_back(i);
+    }
+    catalog.Register({"RECORDS", "SALES", "INTERNATIONAL"},
+                     std::make_shared<riel::execution::Table>(
+                         std::move(international)));
+  }
+
+  ~MemoTest() noexcept;
+
+  static Plan::Ptr Parse(const std::string &plan) {
+    std::istringstream stream{plan};
+    return Plan::Persist(*riel::StreamParser{stream}.parse());
+  }
+
+  std::vector<Row> Execute(const Plan &plan) const {
+    const riel::execution::Executor executor{catalog};
+    const auto                      op   = executor.Compile(*plan.Thaw());
+    auto                            rows = riel::execution::Materialize(*op);
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  }
+
+  riel::execution::Catalog catalog;
+};
+
+MemoTest::~MemoTest() noexcept = default;
+
+const std::string kAggregateOverUnion =
+    "Aggregate(group=[{0, 1}])\n"
+    "  Union(all=[true])\n"
+    "    Project(SECTOR=[$0], NAME=[$1])\n"
+    "      Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+    "    Project(SECTOR=[$0], NAME=[$1])\n"
+    "      Scan(table=[[RECORDS, SALES, INTERNATIONAL]])";
+
+/** Streaming costs as much as hashing. */
+class StreamingHashes : public riel::optimizer::CostModel {
+public:
+  StreamingHashes() = default;
+  ~StreamingHashes() final;
+
+  double Cost(const Physical::type            physical,
+              const std::vector<std::size_t> &inputs,
+              const std::size_t               output) const final {
+    return model_.Cost(Physical::STREAMING_AGGREGATE == physical
+                           ? Physical::HASH_AGGREGATE
+                           : physical,
+                       inputs,
+                       output);
+  }
+
+private:
+  const riel::optimizer::DefaultCostModel model_;
+};
+
+StreamingHashes::~StreamingHashes() = default;
+
+TEST_F(MemoTest, PushPartialAggregatesBelowUnionAll) {
+  const auto                              plan = Parse(kAggregateOverUnion);
+  const riel::optimizer::DefaultCostModel model;
+  riel::optimizer::Memo                   memo{catalog, model, 4};
+  const auto                              root = memo.Insert(plan);
+
+  EXPECT_EQ("HashAggregate(group=[{0, 1}])\n"
+            "  Union(all=[true])\n"
+            "    StreamingAggregate(group=[{0, 1}])\n"
+            "      Project(SECTOR=[$0], NAME=[$1])\n"
+            "        Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+            "    HashAggregate(group=[{0, 1}])\n"
+            "      Project(SECTOR=[$0], NAME=[$1])\n"
+            "        Scan(table=[[RECORDS, SALES, INTERNATIONAL]])",
+            memo.Explain(root));
+
+  const auto optimized = memo.Extract(root);
+  EXPECT_EQ(riel::Type::AGGREGATE, Plan::At(optimized, {0, 0})->id());
+  EXPECT_EQ(riel::Type::AGGREGATE, Plan::At(optimized, {0, 1})->id());
+
+  const auto rows = Execute(*optimized);
+  EXPECT_EQ(Execute(*plan), rows);
+  EXPECT_EQ(100, rows.size());
+}
+
+TEST_F(MemoTest, ExploreUnionOrders) {
+  const riel::optimizer::DefaultCostModel model;
+  riel::optimizer::Memo                   memo{catalog, model, 1};
+  const auto root = memo.Insert(Parse(kAggregateOverUnion));
+  memo.Explore(root);
+
+  const auto aggregates = memo.Expressions(root);
+  ASSERT_EQ(2, aggregates.size());
+  EXPECT_FALSE(aggregates[0].pushed);
+  EXPECT_TRUE(aggregates[1].pushed);
+
+  for (const auto &aggregate : aggregates) {
+    const auto unions = memo.Expressions(aggregate.children[0]);
+    ASSERT_EQ(2, unions.size());
+    EXPECT_EQ(unions[0].children[0], unions[1].children[1]);
+    EXPECT_EQ(unions[0].children[1], unions[1].children[0]);
+  }
+  EXPECT_EQ(1100, memo.rows(aggregates[0].children[0]));
+  EXPECT_EQ(110, memo.rows(aggregates[1].children[0]));
+}
+
+TEST_F(MemoTest, PlugCostModel) {
+  const auto plan = Parse(kAggregateOverUnion);
+
+  EXPECT_NE(kAggregateOverUnion,
+            riel::persistent::Format(*riel::optimizer::Optimize(
+                plan, catalog, riel::optimizer::DefaultCostModel{})));
+  EXPECT_EQ(kAggregateOverUnion,
+            riel::persistent::Format(
+                *riel::optimizer::Optimize(plan, catalog, StreamingHashes{})));
+}
+
+TEST_F(MemoTest, LimitOrderedInputs) {
+  const riel::optimizer::DefaultCostModel model;
+  riel::optimizer::Memo                   memo{catalog, model};
+
+  EXPECT_EQ("Limit(sort0=[$0], dir0=[ASC], fetch=[10])\n"
+            "  Scan(table=[[RECORDS, SALES, NATIONAL]])",
+            memo.Explain(memo.Insert(
+                Parse("Sort(sort0=[$0], dir0=[ASC], fetch=[10])\n"
+                      "  Scan(table=[[RECORDS, SALES, NATIONAL]])"))));
+  EXPECT_EQ("TopN(sort0=[$0], dir0=[ASC], fetch=[10])\n"
+            "  Scan(table=[[RECORDS, SALES, INTERNATIONAL]])",
+            memo.Explain(memo.Insert(
+                Parse("Sort(sort0=[$0], dir0=[ASC], fetch=[10])\n"
+                      "  Scan(table=[[RECORDS, SALES, INTERNATIONAL]])"))));
+}
+
+TEST_F(MemoTest, RejectRequiredKeysOutsideProjection) {
+  const riel::optimizer::DefaultCostModel model;
+  riel::optimizer::Memo                   memo{catalog, model};
+  const auto                              root =
+      memo.Insert(Parse("Project(SECTOR=[$0])\n"
+                        "  Scan(table=[[RECORDS, SALES, NATIONAL]])"));
+
+  EXPECT_NE(nullptr, memo.Optimize(root, {0}));
+  EXPECT_THROW(memo.Optimize(root, {1}), std::runtime_error);
+}
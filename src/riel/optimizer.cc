@@ -0,0 +1,12 @@
+#include "optimizer.h"
+
+namespace riel {
+namespace optimizer {
+
+CostModel::~CostModel()               = default;
+DefaultCostModel::~DefaultCostModel() = default;
+
+Memo::~Memo() = default;
+
+}  // namespace optimizer
+}  // namespace riel
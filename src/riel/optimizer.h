@@ -0,0 +1,705 @@
+#ifndef RIEL_OPTIMIZER_H_
+#define RIEL_OPTIMIZER_H_
+
+#include "execution.h"
+#include "persistent.h"
+
+#include <cmath>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace riel {
+namespace optimizer {
+
+// = = = = =
+// Costing
+// = = = = =
+
+/** Operators the executor may compile an expression into. */
+struct Physical {
+  enum type : std::size_t {
+    SCAN,
+    FILTER,
+    PROJECT,
+    UNION_ALL,
+    UNION_DISTINCT,
+    HASH_AGGREGATE,
+    STREAMING_AGGREGATE,
+    HASH_JOIN,
+    SORT,
+    TOP_N,
+    LIMIT,  // Sorts of already ordered inputs.
+  };
+
+  static const char *name(const type physical) noexcept {
+    static const char *const names[] = {"Scan",
+                                        "Filter",
+                                        "Project",
+                                        "Union",
+                                        "Union",
+                                        "HashAggregate",
+                                        "StreamingAggregate",
+                                        "HashJoin",
+                                        "Sort",
+                                        "TopN",
+                                        "Limit"};
+    return names[physical];
+  }
+};
+
+/**
+ * Estimates the cost of running one physical operator alone, from the
+ * estimated rows of each of its inputs and of its output. The cost of a plan
+ * is the sum over its operators.
+ */
+class RIEL_EXPORT CostModel {
+public:
+  CostModel() = default;
+  virtual ~CostModel();
+
+  virtual double Cost(Physical::type                  physical,
+                      const std::vector<std::size_t> &inputs,
+                      std::size_t                     output) const = 0;
+
+private:
+  RIEL_DISALLOW_ALL(CostModel);
+};
+
+/**
+ * Counts the rows each operator handles. Filters and projections run within
+ * the scans, hash tables cost `kHashing` per row and sorts n log n.
+ */
+class RIEL_EXPORT DefaultCostModel : public CostModel {
+public:
+  static constexpr double kHashing   = 2;
+  static constexpr double kFiltering = 0.25;
+
+  DefaultCostModel() = default;
+  ~DefaultCostModel() final;
+
+  double Cost(const Physical::type            physical,
+              const std::vector<std::size_t> &inputs,
+              const std::size_t               output) const final {
+    double input = 0;
+    for (const auto rows : inputs) { input += static_cast<double>(rows); }
+    const auto rows = static_cast<double>(output);
+
+    switch (physical) {
+    case Physical::SCAN:
+      return rows;
+    case Physical::FILTER:
+      return kFiltering * input;
+    case Physical::PROJECT:
+    case Physical::UNION_ALL:
+      return 0;
+    case Physical::UNION_DISTINCT:
+      return kHashing * input;
+    case Physical::HASH_AGGREGATE:
+      return kHashing * input + rows;
+    case Physical::STREAMING_AGGREGATE:
+      return input;
+    case Physical::HASH_JOIN: {
+      const auto build = static_cast<double>(
+          *std::min_element(inputs.cbegin(), inputs.cend()));
+      return kHashing * build + (input - build) + rows;
+    }
+    case Physical::SORT:
+      return input * std::log2(input + 1);
+    case Physical::TOP_N:
+      return input * std::log2(rows + 1);
+    case Physical::LIMIT:
+      return rows;
+    }
+    return 0;
+  }
+
+private:
+  RIEL_DISALLOW_ALL(DefaultCostModel);
+};
+
+// = = = =
+// Memo
+// = = = =
+
+using GroupId = std::size_t;
+
+/** Childless operation over groups: one alternative of the group holding it. */
+struct RIEL_EXPORT Expression {
+  std::shared_ptr<const Node> operation;
+  std::vector<GroupId>        children;
+  bool                        pushed;  // Merges partial aggregates.
+};
+
+/** Cheapest implementation of a group delivering a required collation. */
+struct RIEL_EXPORT Winner {
+  Expression                        expression;
+  Physical::type                    physical;
+  std::vector<execution::Collation> requirements;  // On each child.
+  execution::Collation              collation;     // Delivered.
+  double                            cost;          // Including the inputs.
+};
+
+/**
+ * Cascades-style search space. A group holds the equivalent expressions of
+ * one subplan, with the logical statistics they share; equal expressions are
+ * stored once. Exploration rules add alternatives to the groups, and each
+ * group is then implemented by the cheapest physical plan under the cost
+ * model for every collation its consumers require. Groups not depending on
+ * each other are explored and optimized in parallel, on up to `threads`
+ * threads, all the hardware ones by default.
+ */
+class RIEL_EXPORT Memo {
+public:
+  /** Unions reordered by exploration, as they take n! alternatives. */
+  static constexpr std::size_t kMaxReorderedInputs = 4;
+
+  Memo(const execution::Catalog &catalog,
+       const CostModel &         model,
+       const std::size_t         threads = 0)
+      : catalog_{catalog}, model_{model}, mutex_{}, groups_{}, index_{},
+        spare_{(0 == threads ? std::max<std::size_t>(
+                                   std::thread::hardware_concurrency(), 1)
+                             : threads) -
+               1} {}
+
+  ~Memo();
+
+  /** Copies in the plan, a group per distinct subplan. Returns its group. */
+  GroupId Insert(const persistent::Plan::Ptr &plan) {
+    std::vector<GroupId> children;
+    children.reserve(plan->children().size());
+    for (const auto &child : plan->children()) {
+      children.push_back(Insert(child));
+    }
+    return Add({plan->operation().Clone(), std::move(children), false});
+  }
+
+  /**
+   * Applies the exploration rules to the group until no new alternatives
+   * show up, after exploring its inputs. Groups the rules add are explored
+   * once the group is done, never from within its own exploration.
+   */
+  void Explore(const GroupId id) {
+    Group &              group = At(id);
+    std::vector<GroupId> added;
+    std::call_once(group.explored, [this, id, &group, &added] {
+      RIEL_TRACE("Memo::Explore");
+
+      ForEach(Inputs(group), [this](const GroupId input) { Explore(input); });
+      for (std::size_t i = 0;; ++i) {
+        Expression expression;
+        {
+          const std::lock_guard<std::mutex> lock{group.mutex};
+          if (i == group.expressions.size()) { break; }
+          expression = group.expressions[i];
+        }
+        Reorder(id, expression);
+        if (const auto merged = PushAggregate(id, expression)) {
+          added.push_back(*merged);
+        }
+      }
+    });
+    ForEach(added, [this](const GroupId merged) { Explore(merged); });
+  }
+
+  /**
+   * Cheapest implementation of the explored group whose output is sorted on
+   * the `required` keys, in any order. Null when no alternative delivers it.
+   */
+  const Winner *Optimize(const GroupId        id,
+                         execution::Collation required = {}) {
+    Explore(id);
+    std::sort(required.begin(), required.end());
+
+    Group &group = At(id);
+    {
+      const std::lock_guard<std::mutex> lock{group.mutex};
+      const auto it = group.winners.find(required);
+      if (group.winners.cend() != it) { return Get(it->second); }
+    }
+
+    RIEL_TRACE("Memo::Optimize");
+    if (required.empty()) {
+      ForEach(Inputs(group), [this](const GroupId input) { Optimize(input); });
+    }
+
+    std::optional<Winner> best;
+    for (const auto &expression : Expressions(id)) {
+      auto winner = Implement(expression, required, group.rows);
+      if (winner && (!best || winner->cost < best->cost)) {
+        best = std::move(winner);
+      }
+    }
+
+    const std::lock_guard<std::mutex> lock{group.mutex};
+    return Get(group.winners.emplace(required, std::move(best)).first->second);
+  }
+
+  /** Cheapest plan of the group, as the executor compiles it. */
+  persistent::Plan::Ptr Extract(const GroupId               id,
+                                const execution::Collation &required = {}) {
+    const Winner &winner = Winning(id, required);
+
+    persistent::Plan::Children children;
+    for (std::size_t i = 0; i < winner.expression.children.size(); ++i) {
+      children.push_back(
+          Extract(winner.expression.children[i], winner.requirements[i]));
+    }
+    return persistent::Plan::Make(winner.expression.operation,
+                                  std::move(children));
+  }
+
+  /** Physical operators of the cheapest plan, one per line. */
+  std::string Explain(const GroupId               id,
+                      const execution::Collation &required = {},
+                      const std::size_t           indent   = 0) {
+    const Winner &    winner    = Winning(id, required);
+    const std::string operation = Format(*winner.expression.operation);
+
+    const auto  arguments = operation.find('(');
+    std::string explain   = std::string(indent, ' ') +
+                            Physical::name(winner.physical) +
+                            (std::string::npos == arguments
+                                 ? std::string{}
+                                 : operation.substr(arguments));
+    for (std::size_t i = 0; i < winner.expression.children.size(); ++i) {
+      explain += "\n" + Explain(winner.expression.children[i],
+                                winner.requirements[i],
+                                indent + 2);
+    }
+    return explain;
+  }
+
+  std::vector<Expression> Expressions(const GroupId id) {
+    Group &                           group = At(id);
+    const std::lock_guard<std::mutex> lock{group.mutex};
+    return std::vector<Expression>(group.expressions.cbegin(),
+                                   group.expressions.cend());
+  }
+
+  std::size_t rows(const GroupId id) { return At(id).rows; }
+
+  std::size_t size() const {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    return groups_.size();
+  }
+
+private:
+  struct Group {
+    Group(const std::size_t group_width, const std::size_t group_rows)
+        : width{group_width}, rows{group_rows}, mutex{}, expressions{},
+          winners{}, explored{} {}
+
+    const std::size_t width;
+    const std::size_t rows;  // Estimated.
+
+    std::mutex                                              mutex;
+    std::deque<Expression>                                  expressions;
+    std::map<execution::Collation, std::optional<Winner>> winners;
+    std::once_flag                                          explored;
+  };
+
+  static const Winner *Get(const std::optional<Winner> &winner) noexcept {
+    return winner ? &*winner : nullptr;
+  }
+
+  Group &At(const GroupId id) {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    if (id >= groups_.size()) {
+      throw std::runtime_error("Bad memo group " + std::to_string(id));
+    }
+    return groups_[id];
+  }
+
+  const Winner &Winning(const GroupId               id,
+                        const execution::Collation &required) {
+    const Winner *winner = Optimize(id, required);
+    if (nullptr == winner) {
+      throw std::runtime_error("No plan of memo group " + std::to_string(id) +
+                               " delivers the required collation");
+    }
+    return *winner;
+  }
+
+  /** Distinct groups the alternatives of `group` consume. */
+  std::vector<GroupId> Inputs(Group &group) {
+    const std::lock_guard<std::mutex> lock{group.mutex};
+    std::vector<GroupId>              inputs;
+    for (const auto &expression : group.expressions) {
+      inputs.insert(inputs.end(),
+                    expression.children.cbegin(),
+                    expression.children.cend());
+    }
+    std::sort(inputs.begin(), inputs.end());
+    inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+    return inputs;
+  }
+
+  /**
+   * Adds the expression to group `into`, or to a new group by default, unless
+   * it is stored already. Returns the group holding it. Equal expressions
+   * found in other groups are not merged into `into`.
+   */
+  GroupId Add(Expression &&expression, std::optional<GroupId> into = {}) {
+    std::string key = Format(*expression.operation);
+    for (const auto child : expression.children) {
+      key += " $" + std::to_string(child);
+    }
+
+    const std::lock_guard<std::mutex> lock{mutex_};
+    const auto                        it = index_.find(key);
+    if (index_.cend() != it) { return it->second; }
+
+    if (!into) {
+      into = groups_.size();
+      const auto &operation = *expression.operation;
+      groups_.emplace_back(Width(operation, expression.children),
+                           Rows(operation, expression.children));
+    }
+    Group &group = groups_[*into];
+    {
+      const std::lock_guard<std::mutex> group_lock{group.mutex};
+      group.expressions.push_back(std::move(expression));
+    }
+    index_.emplace(std::move(key), *into);
+    return *into;
+  }
+
+  // = = = = = =
+  // Statistics
+  // = = = = = =
+
+  // As derived by execution::PropertiesDeriver, with the memo locked.
+
+  std::size_t Width(const Node &                operation,
+                    const std::vector<GroupId> &children) const {
+    switch (operation.id()) {
+    case Type::SCAN:
+      return catalog_
+          .Description(dynamic_cast<const ScanNode &>(operation).path())
+          .width;
+    case Type::AGGREGATE:
+      return dynamic_cast<const AggregateNode &>(operation)
+          .group_indices()
+          .size();
+    case Type::PROJECT:
+      return dynamic_cast<const ProjectNode &>(operation).pairs().size();
+    case Type::JOIN:
+      return groups_[children[0]].width + groups_[children[1]].width;
+    case Type::UNION:
+    case Type::FILTER:
+    case Type::SORT:
+      break;
+    }
+    return groups_[children[0]].width;
+  }
+
+  std::size_t Rows(const Node &                operation,
+                   const std::vector<GroupId> &children) const {
+    switch (operation.id()) {
+    case Type::SCAN:
+      return catalog_
+          .Description(dynamic_cast<const ScanNode &>(operation).path())
+          .rows;
+    case Type::UNION: {
+      std::size_t rows = 0;
+      for (const auto child : children) { rows += groups_[child].rows; }
+      return rows;
+    }
+    case Type::AGGREGATE:
+      return execution::EstimateGroups(groups_[children[0]].rows);
+    case Type::FILTER:
+      return execution::EstimateFiltered(
+          groups_[children[0]].rows,
+          dynamic_cast<const FilterNode &>(operation).conjuncts().size());
+    case Type::JOIN:
+      return std::max(groups_[children[0]].rows, groups_[children[1]].rows);
+    case Type::SORT: {
+      const auto &fetch = dynamic_cast<const SortNode &>(operation).fetch();
+      return std::min(groups_[children[0]].rows,
+                      fetch ? *fetch : groups_[children[0]].rows);
+    }
+    case Type::PROJECT:
+      break;
+    }
+    return groups_[children[0]].rows;
+  }
+
+  // = = = = = = = = = =
+  // Exploration rules
+  // = = = = = = = = = =
+
+  /** Union inputs in every order, through swaps of adjacent inputs. */
+  void Reorder(const GroupId id, const Expression &expression) {
+    const auto &children = expression.children;
+    if (Type::UNION != expression.operation->id() ||
+        children.size() > kMaxReorderedInputs) {
+      return;
+    }
+    for (std::size_t i = 1; i < children.size(); ++i) {
+      std::vector<GroupId> reordered{children};
+      std::swap(reordered[i - 1], reordered[i]);
+      Add({expression.operation, std::move(reordered), false}, id);
+    }
+  }
+
+  /**
+   * Aggregate over Union(all=true) into a merging aggregate over the union of
+   * a partial aggregate per input: partials may stream over sorted inputs
+   * and the merge only sees their groups. Returns the group of the union of
+   * partials, left for the caller to explore.
+   */
+  std::optional<GroupId> PushAggregate(const GroupId     id,
+                                       const Expression &expression) {
+    if (Type::AGGREGATE != expression.operation->id() || expression.pushed) {
+      return std::nullopt;
+    }
+
+    const auto inputs = Expressions(expression.children[0]);
+    const auto _union =
+        std::find_if(inputs.cbegin(), inputs.cend(), [](const auto &input) {
+          return Type::UNION == input.operation->id() &&
+                 input.children.size() > 1 &&
+                 dynamic_cast<const UnionNode &>(*input.operation).all();
+        });
+    if (inputs.cend() == _union) { return std::nullopt; }
+
+    std::vector<GroupId> partials;
+    for (const auto child : _union->children) {
+      partials.push_back(Add({expression.operation, {child}, false}));
+    }
+    const GroupId merged = Add({_union->operation, std::move(partials), false});
+
+    const auto &group_indices =
+        dynamic_cast<const AggregateNode &>(*expression.operation)
+            .group_indices();
+    std::vector<std::size_t> merging(group_indices.size());
+    std::iota(merging.begin(), merging.end(), 0);
+    Add({std::make_shared<AggregateNode>(std::move(merging)), {merged}, true},
+        id);
+    return merged;
+  }
+
+  // = = = = = = = =
+  // Implementation
+  // = = = = = = = =
+
+  /**
+   * Cheapest physical operator for the expression delivering `required`,
+   * over the winners of its inputs, as execution::Executor compiles it.
+   */
+  std::optional<Winner> Implement(const Expression &          expression,
+                                  const execution::Collation &required,
+                                  const std::size_t           output) {
+    const Node &operation = *expression.operation;
+    const auto &children  = expression.children;
+
+    std::optional<Winner> best;
+    const auto consider = [&](const Physical::type                physical,
+                              std::vector<execution::Collation> &&requirements,
+                              const auto &                        deliver) {
+      std::vector<const Winner *> inputs;
+      std::vector<std::size_t>    rows;
+      for (std::size_t i = 0; i < children.size(); ++i) {
+        inputs.push_back(Optimize(children[i], requirements[i]));
+        if (nullptr == inputs.back()) { return; }
+        rows.push_back(At(children[i]).rows);
+      }
+
+      execution::Collation collation = deliver(inputs);
+      if (!required.empty() && !execution::IsSortedOn(collation, required)) {
+        return;
+      }
+
+      double cost = model_.Cost(physical, rows, output);
+      for (const auto *input : inputs) { cost += input->cost; }
+      if (!best || cost < best->cost) {
+        best = Winner{expression,
+                      physical,
+                      std::move(requirements),
+                      std::move(collation),
+                      cost};
+      }
+    };
+    const auto same = [](const std::vector<const Winner *> &inputs) {
+      return inputs[0]->collation;
+    };
+
+    switch (operation.id()) {
+    case Type::SCAN: {
+      const auto &path = dynamic_cast<const ScanNode &>(operation).path();
+      consider(Physical::SCAN, {}, [&](const auto &) {
+        return catalog_.Description(path).collation;
+      });
+      break;
+    }
+    case Type::FILTER:
+      consider(Physical::FILTER, {required}, same);
+      break;
+    case Type::PROJECT: {
+      const auto &project = dynamic_cast<const ProjectNode &>(operation);
+      const auto &pairs   = project.pairs();
+
+      execution::Collation mapped;
+      for (const auto key : required) {
+        if (key >= pairs.size()) {
+          throw std::runtime_error("Column $" + std::to_string(key) +
+                                   " out of range: " +
+                                   static_cast<std::string>(project));
+        }
+        mapped.push_back(pairs[key].second);
+      }
+      consider(Physical::PROJECT, {std::move(mapped)}, [&](const auto &inputs) {
+        execution::Collation collation;
+        for (const auto key : inputs[0]->collation) {
+          const auto it = std::find_if(
+              pairs.cbegin(), pairs.cend(), [key](const auto &pair) {
+                return key == pair.second;
+              });
+          if (pairs.cend() == it) { break; }
+          collation.push_back(static_cast<std::size_t>(it - pairs.cbegin()));
+        }
+        return collation;
+      });
+      break;
+    }
+    case Type::UNION: {
+      const bool all = dynamic_cast<const UnionNode &>(operation).all();
+      if (1 == children.size()) {
+        consider(all ? Physical::UNION_ALL : Physical::UNION_DISTINCT,
+                 {required},
+                 same);
+      } else {
+        consider(all ? Physical::UNION_ALL : Physical::UNION_DISTINCT,
+                 std::vector<execution::Collation>(children.size()),
+                 [](const auto &) { return execution::Collation{}; });
+      }
+      break;
+    }
+    case Type::AGGREGATE: {
+      const auto &group =
+          dynamic_cast<const AggregateNode &>(operation).group_indices();
+      const auto deliver = [&](const auto &inputs) {
+        execution::Collation collation;
+        if (execution::IsSortedOn(inputs[0]->collation, group)) {
+          for (std::size_t i = 0; i < group.size(); ++i) {
+            const auto it = std::find(
+                group.cbegin(), group.cend(), inputs[0]->collation[i]);
+            collation.push_back(static_cast<std::size_t>(it - group.cbegin()));
+          }
+        }
+        return collation;
+      };
+
+      // The executor streams over every input sorted on the group.
+      const Winner *input = Optimize(children[0]);
+      if (nullptr != input &&
+          !execution::IsSortedOn(input->collation, group)) {
+        consider(Physical::HASH_AGGREGATE, {{}}, deliver);
+      }
+      consider(Physical::STREAMING_AGGREGATE, {group}, deliver);
+      break;
+    }
+    case Type::JOIN:
+      consider(Physical::HASH_JOIN, {{}, {}}, [&](const auto &inputs) {
+        const auto &left  = At(children[0]);
+        const auto &right = At(children[1]);
+        if (!execution::PropertiesDeriver::BuildsLeft(
+                {{}, left.width, left.rows}, {{}, right.width, right.rows})) {
+          return inputs[0]->collation;
+        }
+
+        execution::Collation collation;
+        for (const auto key : inputs[1]->collation) {
+          collation.push_back(left.width + key);
+        }
+        return collation;
+      });
+      break;
+    case Type::SORT: {
+      const auto &sort  = dynamic_cast<const SortNode &>(operation);
+      const auto  input = Optimize(children[0]);
+      if (nullptr == input) { break; }
+
+      const auto physical =
+          execution::Executor::IsOrdered(input->collation, sort.keys())
+              ? Physical::LIMIT
+              : sort.fetch() ? Physical::TOP_N : Physical::SORT;
+      consider(physical, {{}}, [&](const auto &inputs) {
+        if (sort.keys().empty()) { return inputs[0]->collation; }
+
+        execution::Collation collation;
+        for (const auto &key : sort.keys()) {
+          if (Direction::ASCENDING != key.direction) { break; }
+          collation.push_back(key.index);
+        }
+        return collation;
+      });
+      break;
+    }
+    }
+    return best;
+  }
+
+  /**
+   * Runs `task` on each group, on as many spare threads as there are and on
+   * the calling one.
+   */
+  template <class Task>
+  void ForEach(const std::vector<GroupId> &ids, Task &&task) {
+    if (ids.empty()) { return; }
+
+    const std::size_t threads = Reserve(ids.size() - 1);
+    try {
+      threading::ThreadPool{threads}.Run(
+          ids.size(), [&](const std::size_t i) { task(ids[i]); });
+    } catch (...) {
+      spare_ += threads;
+      throw;
+    }
+    spare_ += threads;
+  }
+
+  /** Takes up to `wanted` spare threads. Returns how many it got. */
+  std::size_t Reserve(const std::size_t wanted) noexcept {
+    std::size_t spare = spare_.load();
+    while (0 < spare) {
+      const std::size_t taken = std::min(spare, wanted);
+      if (spare_.compare_exchange_weak(spare, spare - taken)) { return taken; }
+    }
+    return 0;
+  }
+
+  const execution::Catalog &               catalog_;
+  const CostModel &                        model_;
+  mutable std::mutex                       mutex_;
+  std::deque<Group>                        groups_;
+  std::unordered_map<std::string, GroupId> index_;
+  std::atomic<std::size_t>                 spare_;
+
+  RIEL_DISALLOW_ALL(Memo);
+};
+
+/**
+ * Cheapest plan equivalent to `plan` under the cost model.
+ */
+inline persistent::Plan::Ptr Optimize(const persistent::Plan::Ptr &plan,
+                                      const execution::Catalog &   catalog,
+                                      const CostModel &            model,
+                                      const std::size_t threads = 0) {
+  Memo memo{catalog, model, threads};
+  return memo.Extract(memo.Insert(plan));
+}
+
+}  // namespace optimizer
+}  // namespace riel
+
+#endif
@@ -0,0 +1,88 @@
+#include <riel/persistent.h>
+
+#include <gtest/gtest.h>
+
+using riel::persistent::Plan;
+
+class PlanTest : public ::testing::Test {
+protected:
+  PlanTest() : plan{} {
+    std::istringstream stream{
+        "Aggregate(group=[{0, 1}])\n"
+        "  Union(all=[true])\n"
+        "    Project(SECTOR=[$0], NAME=[$1])\n"
+        "      Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+        "    Project(SECTOR=[$0], NAME=[$1])\n"
+        "      Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n"};
+    plan = Plan::Persist(*riel::StreamParser{stream}.parse());
+  }
+
+  ~PlanTest() noexcept;
+
+  static std::shared_ptr<const riel::Node>
+  Scan(std::vector<std::string> &&path) {
+    return std::make_shared<riel::ScanNode>(std::move(path));
+  }
+
+  Plan::Ptr plan;
+};
+
+PlanTest::~PlanTest() noexcept = default;
+
+TEST_F(PlanTest, PersistAndThaw) {
+  const std::string format =
+      "Aggregate(group=[{0, 1}])\n"
+      "  Union(all=[true])\n"
+      "    Project(SECTOR=[$0], NAME=[$1])\n"
+      "      Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+      "    Project(SECTOR=[$0], NAME=[$1])\n"
+      "      Scan(table=[[RECORDS, SALES, INTERNATIONAL]])";
+
+  EXPECT_EQ(format, riel::persistent::Format(*plan));
+  EXPECT_EQ(format, riel::Format(*plan->Thaw()));
+  EXPECT_EQ(riel::Type::AGGREGATE, plan->id());
+}
+
+TEST_F(PlanTest, ReplaceCopiesOnlyThePath) {
+  const auto replaced =
+      Plan::Replace(plan, {0, 1, 0}, Plan::Make(Scan({"RECORDS", "OTHER"})));
+
+  EXPECT_NE(plan, replaced);
+  EXPECT_NE(Plan::At(plan, {0}), Plan::At(replaced, {0}));
+  EXPECT_NE(Plan::At(plan, {0, 1}), Plan::At(replaced, {0, 1}));
+  EXPECT_EQ(Plan::At(plan, {0, 0}), Plan::At(replaced, {0, 0}));
+  EXPECT_EQ(&plan->operation(), &replaced->operation());
+
+  EXPECT_EQ("Scan(table=[[RECORDS, SALES, INTERNATIONAL]])",
+            riel::persistent::Format(*Plan::At(plan, {0, 1, 0})));
+  EXPECT_EQ("Scan(table=[[RECORDS, OTHER]])",
+            riel::persistent::Format(*Plan::At(replaced, {0, 1, 0})));
+}
+
+TEST_F(PlanTest, TransformSharesUnchangedSubtrees) {
+  const auto identity = Plan::Transform(
+      plan, [](const Plan::Ptr &node) -> Plan::Ptr { return node; });
+  EXPECT_EQ(plan, identity);
+
+  const auto distinct =
+      Plan::Transform(plan, [](const Plan::Ptr &node) -> Plan::Ptr {
+        if (riel::Type::UNION != node->id()) { return node; }
+        return node->WithOperation(std::make_shared<riel::UnionNode>(false));
+      });
+
+  EXPECT_FALSE(dynamic_cast<const riel::UnionNode &>(
+                   Plan::At(distinct, {0})->operation())
+                   .all());
+  EXPECT_EQ(Plan::At(plan, {0, 0}), Plan::At(distinct, {0, 0}));
+  EXPECT_EQ(Plan::At(plan, {0, 1}), Plan::At(distinct, {0, 1}));
+}
+
+TEST_F(PlanTest, RejectOperationsWithChildren) {
+  auto project = std::make_shared<riel::ProjectNode>(
+      std::vector<std::pair<std::string, std::size_t>>{{"NAME", 1}});
+  project->children().append(
+      std::make_unique<riel::ScanNode>(std::vector<std::string>{"RECORDS"}));
+
+  EXPECT_THROW(Plan::Make(project), std::runtime_error);
+  EXPECT_THROW(Plan::At(plan, {0, 2}), std::runtime_error);
+}
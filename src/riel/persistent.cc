@@ -0,0 +1,9 @@
+#include "persistent.h"
+
+namespace riel {
+namespace persistent {
+
+Plan::~Plan() = default;
+
+}  // namespace persistent
+}  // namespace riel
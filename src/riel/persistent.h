@@ -0,0 +1,158 @@
+#ifndef RIEL_PERSISTENT_H_
+#define RIEL_PERSISTENT_H_
+
+#include "riel.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace riel {
+namespace persistent {
+
+/**
+ * Immutable, reference counted plan tree. Each node pairs its operation, a
+ * childless Node holding the properties, with children shared by every
+ * version of the plan that did not change them. Rewriting a node copies only
+ * the path back to the root.
+ */
+class RIEL_EXPORT Plan {
+public:
+  using Ptr      = std::shared_ptr<const Plan>;
+  using Children = std::vector<Ptr>;
+
+  /** Child indices leading from a root down to one of its nodes. */
+  using Path = std::vector<std::size_t>;
+
+  Plan(std::shared_ptr<const Node> operation, Children &&children)
+      : operation_{std::move(operation)}, children_{std::move(children)} {
+    if (0 != operation_->children().size()) {
+      throw std::runtime_error("Plan operation with children: " +
+                               riel::Format(*operation_));
+    }
+  }
+
+  ~Plan();
+
+  /** Charged to the memory tracker in scope. */
+  static Ptr Make(std::shared_ptr<const Node> operation,
+                  Children &&                 children = {}) {
+    return std::allocate_shared<Plan>(
+        memory::Allocator<Plan>{}, std::move(operation), std::move(children));
+  }
+
+  /** Persistent copy of the tree rooted at `node`. */
+  static Ptr Persist(const Node &node) {
+    Children children;
+    children.reserve(node.children().size());
+    for (std::size_t i = 0; i < node.children().size(); ++i) {
+      children.push_back(Persist(*node.children()[i]));
+    }
+    return Make(node.Clone(), std::move(children));
+  }
+
+  /** Mutable copy of the tree, as compiled by the executor. */
+  std::unique_ptr<Node> Thaw() const {
+    auto node = operation_->Clone();
+    for (const auto &child : children_) {
+      node->children().append(child->Thaw());
+    }
+    return node;
+  }
+
+  const Node &operation() const noexcept { return *operation_; }
+
+  const Children &children() const noexcept { return children_; }
+
+  Type::type id() const noexcept { return operation_->id(); }
+
+  /** This operation over other children. */
+  Ptr WithChildren(Children &&children) const {
+    return Make(operation_, std::move(children));
+  }
+
+  /** Another operation over the same children. */
+  Ptr WithOperation(std::shared_ptr<const Node> operation) const {
+    return Make(std::move(operation), Children{children_});
+  }
+
+  static const Ptr &At(const Ptr &root, const Path &path) {
+    const Ptr *node = &root;
+    for (const auto index : path) {
+      if (index >= (*node)->children_.size()) {
+        throw std::runtime_error("Bad plan path at child " +
+                                 std::to_string(index));
+      }
+      node = &(*node)->children_[index];
+    }
+    return *node;
+  }
+
+  /**
+   * Version of `root` with the node at `path` replaced. Only the nodes along
+   * the path are copied.
+   */
+  static Ptr Replace(const Ptr &root, const Path &path, Ptr replacement) {
+    return Replace(root, path.cbegin(), path.cend(), std::move(replacement));
+  }
+
+  /**
+   * Rewrites bottom-up: `rewrite` takes each node over its rewritten children
+   * and returns it or a replacement. Unchanged subtrees, and an unchanged
+   * tree, are returned as they were.
+   */
+  template <class Rewrite>
+  static Ptr Transform(const Ptr &root, Rewrite &&rewrite) {
+    Children children;
+    children.reserve(root->children_.size());
+
+    bool changed = false;
+    for (const auto &child : root->children_) {
+      children.push_back(Transform(child, rewrite));
+      changed = changed || children.back() != child;
+    }
+    return rewrite(changed ? root->WithChildren(std::move(children)) : root);
+  }
+
+private:
+  static Ptr Replace(const Ptr &                node,
+                     const Path::const_iterator begin,
+                     const Path::const_iterator end,
+                     Ptr                        replacement) {
+    if (begin == end) { return replacement; }
+    if (*begin >= node->children_.size()) {
+      throw std::runtime_error("Bad plan path at child " +
+                               std::to_string(*begin));
+    }
+
+    Children children{node->children_};
+    children[*begin] = Replace(
+        children[*begin], std::next(begin), end, std::move(replacement));
+    return node->WithChildren(std::move(children));
+  }
+
+  const std::shared_ptr<const Node> operation_;
+  const Children                    children_;
+
+  RIEL_DISALLOW_ALL(Plan);
+};
+
+/**
+ * Text format of the plan, as read by StreamParser.
+ */
+inline std::string Format(const Plan &plan, const std::size_t indent = 0) {
+  const auto &operation =
+      dynamic_cast<const Representable &>(plan.operation());
+
+  std::string format =
+      std::string(indent, ' ') + static_cast<std::string>(operation);
+  for (const auto &child : plan.children()) {
+    format += "\n" + Format(*child, indent + 2);
+  }
+  return format;
+}
+
+}  // namespace persistent
+}  // namespace riel
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+
 class FormattedNodeTest : public ::testing::Test {
 protected:
   ~FormattedNodeTest() noexcept;
@@ -118,3 +120,261 @@ TEST_F(StreamParserTest, ParseFourLevelsWithASibling) {
   EXPECT_EQ((std::vector<std::string>{"RECORDS", "SALES", "INTERNATIONAL"}),
             scan2->path());
 }
+
+class MemoryTrackerTest : public ::testing::Test {
+protected:
+  ~MemoryTrackerTest() noexcept;
+};
+
+MemoryTrackerTest::~MemoryTrackerTest() noexcept = default;
+
+TEST_F(MemoryTrackerTest, ChargeParsedPlanToScope) {
+  auto plan = riel::memory::Tracker::Process().MakeChild("plan");
+
+  std::istringstream stream{
+      "Union(all=[true])\n"
+      "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+      "  Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n"};
+
+  std::unique_ptr<riel::Node> root;
+  {
+    const riel::memory::Scope scope{*plan};
+    root = riel::StreamParser{stream}.parse();
+  }
+
+  EXPECT_LT(0, plan->current());
+  EXPECT_LE(plan->current(), plan->peak());
+  EXPECT_LE(plan->current(), riel::memory::Tracker::Process().current());
+
+  root.reset();
+  EXPECT_EQ(0, plan->current());
+  EXPECT_LT(0, plan->peak());
+}
+
+TEST_F(MemoryTrackerTest, ChargeNodeMembersToScope) {
+  const auto charge = [](const std::string &literal) {
+    auto plan = riel::memory::Tracker::Process().MakeChild("plan");
+
+    std::istringstream stream{"Filter(condition=[=($0, '" + literal + "')])\n"
+                              "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n"};
+
+    const riel::memory::Scope scope{*plan};
+    const auto                root = riel::StreamParser{stream}.parse();
+    return plan->current();
+  };
+
+  EXPECT_LE(charge("A") + 1000, charge(std::string(1000, 'A')));
+}
+
+TEST_F(MemoryTrackerTest, ChargePoolThreadsToScope) {
+  auto plan = riel::memory::Tracker::Process().MakeChild("plan");
+
+  const riel::memory::Scope            scope{*plan};
+  riel::threading::ThreadPool          pool{3};
+  std::vector<riel::memory::Tracker *> trackers(8);
+
+  for (int round = 0; round < 2; ++round) {
+    pool.Run(trackers.size(), [&trackers](const std::size_t i) {
+      trackers[i] = &riel::memory::Scope::Current();
+    });
+    for (const auto *tracker : trackers) { EXPECT_EQ(plan.get(), tracker); }
+  }
+
+  EXPECT_THROW(pool.Run(4,
+                        [](const std::size_t i) {
+                          if (2 == i) { throw std::runtime_error("failed"); }
+                        }),
+               std::runtime_error);
+}
+
+TEST_F(MemoryTrackerTest, FailPlanOverLimit) {
+  auto plan = riel::memory::Tracker::Process().MakeChild("plan-7", 64);
+
+  std::istringstream stream{
+      "Union(all=[true])\n"
+      "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+      "  Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n"};
+
+  const riel::memory::Scope scope{*plan};
+  try {
+    riel::StreamParser{stream}.parse();
+    FAIL() << "Expected MemoryLimitExceeded";
+  } catch (const riel::memory::MemoryLimitExceeded &error) {
+    EXPECT_NE(std::string::npos,
+              std::string{error.what()}.find("64 bytes exceeded by "
+                                             "process/plan-7"));
+  }
+  EXPECT_EQ(0, plan->current());
+}
+
+TEST_F(StreamParserTest, ParseAndFormatFilter) {
+  std::istringstream stream{
+      "Filter(condition=[AND(=($0, 'FOOD'), >=($2, -3))])\n"
+      "  Filter(condition=[<>($1, 'PEAR')])\n"
+      "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n"};
+  riel::StreamParser parser = riel::StreamParser{stream};
+
+  const auto root = parser.parse();
+
+  EXPECT_EQ(riel::Type::FILTER, root->id());
+  const auto *filter = dynamic_cast<riel::FilterNode *>(root.get());
+  EXPECT_EQ((std::vector<riel::Comparison>{
+                {0, riel::Literal{"FOOD"}, riel::Comparator::EQUALS},
+                {2,
+                 riel::Literal{std::int64_t{-3}},
+                 riel::Comparator::GREATER_THAN_OR_EQUAL},
+            }),
+            filter->conjuncts());
+
+  EXPECT_EQ(("Filter(condition=[AND(=($0, 'FOOD'), >=($2, -3))])\n"
+             "  Filter(condition=[<>($1, 'PEAR')])\n"
+             "    Scan(table=[[RECORDS, SALES, NATIONAL]])"),
+            riel::Format(*root));
+}
+
+TEST_F(StreamParserTest, RoundTripQuotedLiterals) {
+  const std::string plan =
+      "Filter(condition=[AND(=($0, 'A)B'), <>($1, 'IT''S'), >($2, 2))])\n"
+      "  Filter(condition=[=($0, '[X], (Y')])\n"
+      "    Scan(table=[[RECORDS, SALES, NATIONAL]])";
+  std::istringstream stream{plan};
+
+  const auto  root   = riel::StreamParser{stream}.parse();
+  const auto *filter = dynamic_cast<riel::FilterNode *>(root.get());
+  EXPECT_EQ((std::vector<riel::Comparison>{
+                {0, riel::Literal{"A)B"}, riel::Comparator::EQUALS},
+                {1, riel::Literal{"IT'S"}, riel::Comparator::NOT_EQUALS},
+                {2,
+                 riel::Literal{std::int64_t{2}},
+                 riel::Comparator::GREATER_THAN},
+            }),
+            filter->conjuncts());
+  EXPECT_EQ(riel::Literal{"[X], (Y"},
+            dynamic_cast<riel::FilterNode &>(*root->children()[0])
+                .conjuncts()[0]
+                .literal);
+
+  EXPECT_EQ(plan, riel::Format(*root));
+}
+
+TEST_F(StreamParserTest, ParseAndFormatJoin) {
+  std::istringstream stream{
+      "Join(condition=[AND(=($0, $3), =($4, $1))], joinType=[inner])\n"
+      "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+      "  Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n"};
+  riel::StreamParser parser = riel::StreamParser{stream};
+
+  const auto root = parser.parse();
+
+  EXPECT_EQ(riel::Type::JOIN, root->id());
+  const auto *join = dynamic_cast<riel::JoinNode *>(root.get());
+  EXPECT_EQ((std::vector<riel::JoinNode::Key>{{0, 3}, {4, 1}}), join->keys());
+  EXPECT_EQ(riel::JoinType::INNER, join->join_type());
+  EXPECT_EQ(2, join->children().size());
+
+  EXPECT_EQ(("Join(condition=[AND(=($0, $3), =($4, $1))], joinType=[inner])\n"
+             "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+             "  Scan(table=[[RECORDS, SALES, INTERNATIONAL]])"),
+            riel::Format(*root));
+}
+
+TEST_F(StreamParserTest, ParseAndFormatSort) {
+  std::istringstream stream{
+      "Sort(sort0=[$1], sort1=[$0], dir0=[ASC], dir1=[DESC], fetch=[100])\n"
+      "  Project(SECTOR=[$0], NAME=[$1], ID=[$2])\n"
+      "    Scan(table=[[RECORDS, SALES, NATIONAL]])\n"};
+  riel::StreamParser parser = riel::StreamParser{stream};
+
+  const auto root = parser.parse();
+
+  EXPECT_EQ(riel::Type::SORT, root->id());
+  const auto *sort = dynamic_cast<riel::SortNode *>(root.get());
+  EXPECT_EQ((std::vector<riel::SortNode::Key>{
+                {1, riel::Direction::ASCENDING},
+                {0, riel::Direction::DESCENDING},
+            }),
+            sort->keys());
+  EXPECT_EQ(100, sort->fetch());
+
+  EXPECT_EQ(
+      ("Sort(sort0=[$1], sort1=[$0], dir0=[ASC], dir1=[DESC], fetch=[100])\n"
+       "  Project(SECTOR=[$0], NAME=[$1], ID=[$2])\n"
+       "    Scan(table=[[RECORDS, SALES, NATIONAL]])"),
+      riel::Format(*root));
+}
+
+class TracerTest : public ::testing::Test {
+protected:
+  ~TracerTest() noexcept;
+
+  void SetUp() override { riel::tracing::Tracer::Clear(); }
+
+  /** Collected events named `name`, with the id of their ring. */
+  static std::vector<std::pair<std::size_t, riel::tracing::Event>>
+  Named(const std::string &name) {
+    auto events = riel::tracing::Tracer::Collect();
+    events.erase(std::remove_if(events.begin(),
+                                events.end(),
+                                [&name](const auto &event) {
+                                  return name != event.second.name;
+                                }),
+                 events.end());
+    return events;
+  }
+};
+
+TracerTest::~TracerTest() noexcept = default;
+
+TEST_F(TracerTest, RecordNestedSpansPerThread) {
+  {
+    const riel::tracing::Span outer{"outer"};
+    { const riel::tracing::Span inner{"inner"}; }
+  }
+  std::thread{[] { const riel::tracing::Span worker{"worker"}; }}.join();
+
+  const auto outer  = Named("outer");
+  const auto inner  = Named("inner");
+  const auto worker = Named("worker");
+  ASSERT_EQ(1, outer.size());
+  ASSERT_EQ(1, inner.size());
+  ASSERT_EQ(1, worker.size());
+
+  EXPECT_EQ(outer[0].first, inner[0].first);
+  EXPECT_NE(outer[0].first, worker[0].first);
+  EXPECT_LE(outer[0].second.begin, inner[0].second.begin);
+  EXPECT_LE(inner[0].second.end, outer[0].second.end);
+
+  std::ostringstream stream;
+  riel::tracing::Tracer::Export(stream);
+  EXPECT_NE(std::string::npos,
+            stream.str().find("{\"name\":\"inner\",\"ph\":\"X\",\"pid\":"));
+}
+
+TEST_F(TracerTest, KeepLatestEventsOfFullRing) {
+  const std::size_t recorded = riel::tracing::Ring::kCapacity + 10;
+
+  std::thread{[recorded] {
+    for (std::size_t i = 0; i < recorded; ++i) {
+      riel::tracing::Tracer::Record("lapped", i, i + 1);
+    }
+  }}.join();
+
+  const auto lapped = Named("lapped");
+  ASSERT_EQ(riel::tracing::Ring::kCapacity, lapped.size());
+  EXPECT_EQ(10, lapped.front().second.begin);
+  EXPECT_EQ(recorded, lapped.back().second.end);
+}
+
+#ifdef RIEL_TRACING
+TEST_F(TracerTest, TraceParsing) {
+  std::istringstream stream{
+      "Union(all=[true])\n"
+      "  Scan(table=[[RECORDS, SALES, NATIONAL]])\n"
+      "  Scan(table=[[RECORDS, SALES, INTERNATIONAL]])\n"};
+  riel::StreamParser{stream}.parse();
+
+  EXPECT_EQ(1, Named("StreamParser::parse").size());
+  EXPECT_EQ(3, Named("StreamParser::MakeNode").size());
+  EXPECT_EQ(2, Named("ScanPropertiesBuilder::Build").size());
+}
+#endif
@@ -1,7 +1,229 @@
 #include "riel.h"
 
+#include <unistd.h>
+
+#include <cstddef>
+#include <iomanip>
+
 namespace riel {
 
+namespace memory {
+
+MemoryLimitExceeded::~MemoryLimitExceeded() = default;
+
+Tracker::~Tracker() = default;
+
+Tracker &Tracker::Process() {
+  static auto &process = *new std::shared_ptr<Tracker>(
+      std::make_shared<Tracker>(Token{}, "process", nullptr, kUnlimited));
+  return *process;
+}
+
+Tracker *&Scope::current() noexcept {
+  static thread_local Tracker *current = nullptr;
+  return current;
+}
+
+namespace {
+
+// Keeps the charged tracker alive ahead of each tracked object.
+struct alignas(alignof(std::max_align_t)) Header {
+  std::shared_ptr<Tracker> tracker;
+};
+
+}  // namespace
+
+void *Tracked::operator new(const std::size_t size) {
+  Tracker &tracker = Scope::Current();
+  tracker.Consume(size);
+
+  void *block;
+  try {
+    block = ::operator new(sizeof(Header) + size);
+  } catch (...) {
+    tracker.Release(size);
+    throw;
+  }
+
+  new (block) Header{tracker.shared_from_this()};
+  return static_cast<Header *>(block) + 1;
+}
+
+void Tracked::operator delete(void *pointer, const std::size_t size) noexcept {
+  Header *header = static_cast<Header *>(pointer) - 1;
+
+  header->tracker->Release(size);
+  header->~Header();
+  ::operator delete(header);
+}
+
+}  // namespace memory
+
+namespace threading {
+
+ThreadPool::ThreadPool(const std::size_t threads)
+    : tracker_{memory::Scope::Current().shared_from_this()}, mutex_{},
+      changed_{}, task_{}, count_{0}, next_{0}, running_{0}, round_{0},
+      stopped_{false}, errors_{}, threads_{} {
+  threads_.reserve(threads);
+  try {
+    for (std::size_t i = 0; i < threads; ++i) {
+      threads_.emplace_back(&ThreadPool::Serve, this);
+    }
+  } catch (...) {
+    Stop();
+    throw;
+  }
+}
+
+ThreadPool::~ThreadPool() { Stop(); }
+
+void ThreadPool::Stop() noexcept {
+  {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    stopped_ = true;
+  }
+  changed_.notify_all();
+  for (auto &thread : threads_) { thread.join(); }
+  threads_.clear();
+}
+
+void ThreadPool::Serve() {
+  const memory::Scope scope{*tracker_};
+
+  std::size_t round = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      changed_.wait(lock, [&] { return stopped_ || round != round_; });
+      if (stopped_) { return; }
+      round = round_;
+    }
+    Work();
+
+    {
+      const std::lock_guard<std::mutex> lock{mutex_};
+      --running_;
+    }
+    changed_.notify_all();
+  }
+}
+
+void ThreadPool::Work() noexcept {
+  for (;;) {
+    std::size_t i;
+    {
+      const std::lock_guard<std::mutex> lock{mutex_};
+      if (next_ == count_) { return; }
+      i = next_++;
+    }
+    try {
+      task_(i);
+    } catch (...) { errors_[i] = std::current_exception(); }
+  }
+}
+
+}  // namespace threading
+
+namespace tracing {
+
+Ring::~Ring() = default;
+
+namespace {
+
+struct Registry {
+  std::mutex                         mutex;
+  std::vector<std::shared_ptr<Ring>> rings;
+  std::vector<std::shared_ptr<Ring>> idle;
+};
+
+Registry &Rings() {
+  static auto &registry = *new Registry{};
+  return registry;
+}
+
+// Hands the ring of an exiting thread over to the next new one.
+struct Lease {
+  std::shared_ptr<Ring> ring;
+
+  ~Lease() {
+    if (!ring) { return; }
+    Registry &                        registry = Rings();
+    const std::lock_guard<std::mutex> lock{registry.mutex};
+    registry.idle.push_back(std::move(ring));
+  }
+};
+
+}  // namespace
+
+Ring &Tracer::Local() noexcept {
+  static thread_local Lease lease;
+  if (!lease.ring) {
+    Registry &                        registry = Rings();
+    const std::lock_guard<std::mutex> lock{registry.mutex};
+    if (registry.idle.empty()) {
+      registry.rings.push_back(
+          std::make_shared<Ring>(registry.rings.size() + 1));
+      lease.ring = registry.rings.back();
+    } else {
+      lease.ring = std::move(registry.idle.back());
+      registry.idle.pop_back();
+    }
+  }
+  return *lease.ring;
+}
+
+std::vector<std::pair<std::size_t, Event>> Tracer::Collect() {
+  Registry &                        registry = Rings();
+  const std::lock_guard<std::mutex> lock{registry.mutex};
+
+  std::vector<std::pair<std::size_t, Event>> collected;
+  std::vector<Event>                         events;
+  for (const auto &ring : registry.rings) {
+    events.clear();
+    ring->Snapshot(events);
+    for (const auto &event : events) {
+      collected.emplace_back(ring->id(), event);
+    }
+  }
+  return collected;
+}
+
+// Complete ("X") events with microsecond timestamps, one thread per ring.
+void Tracer::Export(std::ostream &ostream) {
+  const auto pid = ::getpid();
+
+  std::ostringstream stream{std::ios_base::out};
+  stream << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  const char *separator = "";
+  for (const auto &collected : Collect()) {
+    const Event &event = collected.second;
+
+    stream << separator << "\n{\"name\":\"";
+    for (const char *c = event.name; '\0' != *c; ++c) {
+      if ('"' == *c || '\\' == *c) { stream << '\\'; }
+      stream << *c;
+    }
+    stream << "\",\"ph\":\"X\",\"pid\":" << pid
+           << ",\"tid\":" << collected.first
+           << ",\"ts\":" << static_cast<double>(event.begin) / 1e3
+           << ",\"dur\":" << static_cast<double>(event.end - event.begin) / 1e3
+           << "}";
+    separator = ",";
+  }
+  stream << "\n]}\n";
+
+  ostream << stream.str();
+}
+
+void Tracer::Clear() {
+  Registry &                        registry = Rings();
+  const std::lock_guard<std::mutex> lock{registry.mutex};
+  for (const auto &ring : registry.rings) { ring->Clear(); }
+}
+
+}  // namespace tracing
+
 Children::~Children()                     = default;
 ContiguousChildren::~ContiguousChildren() = default;
 
@@ -15,6 +237,9 @@ ScanNode::~ScanNode()           = default;
 UnionNode::~UnionNode()         = default;
 AggregateNode::~AggregateNode() = default;
 ProjectNode::~ProjectNode()     = default;
+FilterNode::~FilterNode()       = default;
+JoinNode::~JoinNode()           = default;
+SortNode::~SortNode()           = default;
 
 RepresentableNode::~RepresentableNode() = default;
 
@@ -28,6 +253,9 @@ UnionPropertiesBuilder::~UnionPropertiesBuilder()         = default;
 ScanPropertiesBuilder::~ScanPropertiesBuilder()           = default;
 AggregatePropertiesBuilder::~AggregatePropertiesBuilder() = default;
 ProjectPropertiesBuilder::~ProjectPropertiesBuilder()     = default;
+FilterPropertiesBuilder::~FilterPropertiesBuilder()       = default;
+JoinPropertiesBuilder::~JoinPropertiesBuilder()           = default;
+SortPropertiesBuilder::~SortPropertiesBuilder()           = default;
 
 PropertiesBuilder::ctype::mask const *PropertiesBuilder::ctype::table() {
   using iterator_type =
@@ -56,6 +284,9 @@ ACCEPT_VISITOR(ScanNode);
 ACCEPT_VISITOR(UnionNode);
 ACCEPT_VISITOR(AggregateNode);
 ACCEPT_VISITOR(ProjectNode);
+ACCEPT_VISITOR(FilterNode);
+ACCEPT_VISITOR(JoinNode);
+ACCEPT_VISITOR(SortNode);
 
 #undef ACCEPT_VISITOR
 
@@ -1,7 +1,17 @@
 #ifndef RIEL_H_
 #define RIEL_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <regex>
+#include <thread>
+#include <variant>
 #include <vector>
 
 // = = = =
@@ -34,12 +44,495 @@
 #define RIEL_INTERNAL __attribute__((visibility("hidden")))
 #endif
 
+// Records the time until the end of the enclosing scope as a trace event
+// named by the string literal `name`. Compiled out unless RIEL_TRACING is set.
+#ifdef RIEL_TRACING
+#define RIEL_TRACE(name)                                                       \
+  const ::riel::tracing::Span RIEL_TRACE_SPAN(__LINE__) { name }
+#define RIEL_TRACE_SPAN(line) RIEL_TRACE_CONCAT(riel_trace_span_, line)
+#define RIEL_TRACE_CONCAT(prefix, line) prefix##line
+#else
+#define RIEL_TRACE(name) static_cast<void>(0)
+#endif
+
 // = = =
 // root
 // = = =
 
 namespace riel {
 
+// = = = =
+// Memory
+// = = = =
+
+namespace memory {
+
+class RIEL_EXPORT MemoryLimitExceeded : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+  ~MemoryLimitExceeded() override;
+};
+
+/**
+ * Accounts bytes for one level of the process -> plan -> operator hierarchy.
+ * Every charge is propagated to the ancestors, and exceeding the limit of any
+ * of them rejects the charge with MemoryLimitExceeded.
+ *
+ * Containers using Allocator and objects deriving from Tracked are charged
+ * as they allocate. Heap payloads held by standard types, such as the
+ * characters of long strings, are charged through a Reservation by whoever
+ * keeps them: nodes for their members, shared columns and operator state for
+ * their string datums.
+ *
+ * Trackers are only made by Process() and MakeChild(), so they are always
+ * shared and allocators may keep them alive.
+ */
+class RIEL_EXPORT Tracker : public std::enable_shared_from_this<Tracker> {
+  struct Token {
+    explicit Token() = default;
+  };
+
+public:
+  static constexpr std::size_t kUnlimited = 0;
+
+  Tracker(Token,
+          std::string              label,
+          std::shared_ptr<Tracker> parent,
+          const std::size_t        limit)
+      : parent_{std::move(parent)}, label_{std::move(label)}, limit_{limit},
+        current_{0}, peak_{0} {}
+
+  ~Tracker();
+
+  /** Root tracker of the whole process. */
+  static Tracker &Process();
+
+  std::shared_ptr<Tracker> MakeChild(std::string       label,
+                                     const std::size_t limit = kUnlimited) {
+    return std::make_shared<Tracker>(
+        Token{}, std::move(label), shared_from_this(), limit);
+  }
+
+  void Consume(const std::size_t bytes) {
+    for (Tracker *tracker = this; nullptr != tracker;
+         tracker          = tracker->parent_.get()) {
+      const std::size_t current = tracker->current_ += bytes;
+      if (kUnlimited != tracker->limit_ && current > tracker->limit_) {
+        for (Tracker *charged = this; tracker != charged;
+             charged          = charged->parent_.get()) {
+          charged->current_ -= bytes;
+        }
+        tracker->current_ -= bytes;
+        throw MemoryLimitExceeded(
+            "Memory limit of " + std::to_string(tracker->limit_) +
+            " bytes exceeded by " + tracker->path() + " allocating " +
+            std::to_string(bytes) + " bytes in " + path() + " (current " +
+            std::to_string(current - bytes) + " bytes)");
+      }
+      std::size_t peak = tracker->peak_;
+      while (peak < current &&
+             !tracker->peak_.compare_exchange_weak(peak, current)) {}
+    }
+  }
+
+  void Release(const std::size_t bytes) noexcept {
+    for (Tracker *tracker = this; nullptr != tracker;
+         tracker          = tracker->parent_.get()) {
+      tracker->current_ -= bytes;
+    }
+  }
+
+  const std::string &label() const noexcept { return label_; }
+
+  std::size_t limit() const noexcept { return limit_; }
+
+  std::size_t current() const noexcept { return current_; }
+
+  std::size_t peak() const noexcept { return peak_; }
+
+  /** Labels from the root, e.g. `process/plan-7/HashAggregate`. */
+  std::string path() const {
+    return parent_ ? parent_->path() + "/" + label_ : label_;
+  }
+
+private:
+  const std::shared_ptr<Tracker> parent_;
+  const std::string              label_;
+  const std::size_t              limit_;
+  std::atomic<std::size_t>       current_;
+  std::atomic<std::size_t>       peak_;
+
+  RIEL_DISALLOW_ALL(Tracker);
+};
+
+/**
+ * Makes `tracker` the one charged by allocations of the calling thread for
+ * the lifetime of the scope.
+ */
+class RIEL_EXPORT Scope {
+public:
+  explicit Scope(Tracker &tracker) noexcept : previous_{current()} {
+    current() = &tracker;
+  }
+
+  ~Scope() { current() = previous_; }
+
+  /** Innermost tracker in scope, or the process one. */
+  static Tracker &Current() noexcept {
+    return nullptr == current() ? Tracker::Process() : *current();
+  }
+
+private:
+  static Tracker *&current() noexcept;
+
+  Tracker *const previous_;
+
+  RIEL_DISALLOW_ALL(Scope);
+};
+
+/**
+ * Standard allocator charging the tracker in scope when it was created, or
+ * the one given.
+ */
+template <class T>
+class Allocator {
+public:
+  using value_type                             = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap            = std::true_type;
+
+  Allocator() : tracker_{Scope::Current().shared_from_this()} {}
+
+  explicit Allocator(std::shared_ptr<Tracker> tracker) noexcept
+      : tracker_{std::move(tracker)} {}
+
+  template <class U>
+  Allocator(const Allocator<U> &other) noexcept  // NOLINT
+      : tracker_{other.tracker()} {}
+
+  T *allocate(const std::size_t size) {
+    tracker_->Consume(size * sizeof(T));
+    try {
+      return std::allocator<T>{}.allocate(size);
+    } catch (...) {
+      tracker_->Release(size * sizeof(T));
+      throw;
+    }
+  }
+
+  void deallocate(T *pointer, const std::size_t size) noexcept {
+    std::allocator<T>{}.deallocate(pointer, size);
+    tracker_->Release(size * sizeof(T));
+  }
+
+  const std::shared_ptr<Tracker> &tracker() const noexcept { return tracker_; }
+
+  template <class U>
+  bool operator==(const Allocator<U> &other) const noexcept {
+    return tracker_ == other.tracker();
+  }
+
+  template <class U>
+  bool operator!=(const Allocator<U> &other) const noexcept {
+    return tracker_ != other.tracker();
+  }
+
+private:
+  std::shared_ptr<Tracker> tracker_;
+};
+
+/**
+ * Bytes held outside any Allocator, charged to a tracker until released or
+ * until the reservation goes. Growing and shrinking may happen concurrently.
+ */
+class RIEL_EXPORT Reservation {
+public:
+  /** Charges the tracker in scope. */
+  explicit Reservation(const std::size_t bytes = 0)
+      : Reservation{Scope::Current().shared_from_this(), bytes} {}
+
+  Reservation(std::shared_ptr<Tracker> tracker, const std::size_t bytes)
+      : tracker_{std::move(tracker)}, bytes_{0} {
+    Grow(bytes);
+  }
+
+  ~Reservation() { tracker_->Release(bytes_); }
+
+  void Grow(const std::size_t bytes) {
+    tracker_->Consume(bytes);
+    bytes_ += bytes;
+  }
+
+  void Shrink(const std::size_t bytes) noexcept {
+    bytes_ -= bytes;
+    tracker_->Release(bytes);
+  }
+
+  std::size_t bytes() const noexcept { return bytes_; }
+
+private:
+  const std::shared_ptr<Tracker> tracker_;
+  std::atomic<std::size_t>       bytes_;
+
+  RIEL_DISALLOW_ALL(Reservation);
+};
+
+/** Heap bytes of `string` beyond the object, none while held inline. */
+inline std::size_t Payload(const std::string &string) noexcept {
+  const auto *object = reinterpret_cast<const char *>(&string);
+  const bool  inline_characters =
+      std::less_equal<const char *>{}(object, string.data()) &&
+      std::less<const char *>{}(string.data(), object + sizeof(string));
+  return inline_characters ? 0 : string.capacity() + 1;
+}
+
+/** Heap bytes of the buffer of `values` and of the strings in it. */
+inline std::size_t Payload(const std::vector<std::string> &values) noexcept {
+  std::size_t bytes = values.capacity() * sizeof(std::string);
+  for (const auto &value : values) { bytes += Payload(value); }
+  return bytes;
+}
+
+/** Heap bytes of the buffer of `values`, whose elements hold none. */
+template <class T>
+std::size_t Payload(const std::vector<T> &values) noexcept {
+  static_assert(std::is_trivially_destructible<T>::value,
+                "Elements holding heap bytes need their own Payload");
+  return values.capacity() * sizeof(T);
+}
+
+/**
+ * Base for heap objects charged to the tracker in scope when allocated.
+ */
+class RIEL_EXPORT Tracked {
+public:
+  static void *operator new(std::size_t size);
+  static void  operator delete(void *pointer, std::size_t size) noexcept;
+};
+
+}  // namespace memory
+
+// = = = = =
+// Threads
+// = = = = =
+
+namespace threading {
+
+/**
+ * Threads running the tasks of one round at a time beside the thread calling
+ * Run(), all charging the memory scope current when the pool was made. They
+ * live until the pool is destroyed, so callers running many rounds pay for
+ * starting them once.
+ */
+class RIEL_EXPORT ThreadPool {
+public:
+  /** Starts `threads` threads; with none, rounds run on the caller. */
+  explicit ThreadPool(std::size_t threads);
+
+  ~ThreadPool();
+
+  /**
+   * Runs `task` for each index below `count` and returns once all are done,
+   * rethrowing the error of the first failed index. Rounds do not overlap:
+   * one caller at a time.
+   */
+  template <class Task>
+  void Run(const std::size_t count, const Task &task) {
+    {
+      const std::lock_guard<std::mutex> lock{mutex_};
+      task_    = [&task](const std::size_t i) { task(i); };
+      count_   = count;
+      next_    = 0;
+      running_ = threads_.size();
+      errors_.assign(count, nullptr);
+      ++round_;
+    }
+    changed_.notify_all();
+    Work();
+
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      changed_.wait(lock, [this] { return 0 == running_; });
+      task_ = nullptr;
+    }
+    for (const auto &error : errors_) {
+      if (error) { std::rethrow_exception(error); }
+    }
+  }
+
+  std::size_t threads() const noexcept { return threads_.size(); }
+
+private:
+  void Stop() noexcept;
+
+  void Serve();
+
+  // Runs tasks of the current round until none is left.
+  void Work() noexcept;
+
+  const std::shared_ptr<memory::Tracker> tracker_;
+  std::mutex                             mutex_;
+  std::condition_variable                changed_;
+  std::function<void(std::size_t)>       task_;
+  std::size_t                            count_;
+  std::size_t                            next_;
+  std::size_t                            running_;
+  std::size_t                            round_;
+  bool                                   stopped_;
+  std::vector<std::exception_ptr>        errors_;
+  std::vector<std::thread>               threads_;
+
+  RIEL_DISALLOW_ALL(ThreadPool);
+};
+
+}  // namespace threading
+
+// = = = = =
+// Tracing
+// = = = = =
+
+namespace tracing {
+
+/**
+ * A named interval, in nanoseconds of the steady clock.
+ */
+struct RIEL_EXPORT Event {
+  const char *  name;
+  std::uint64_t begin;
+  std::uint64_t end;
+};
+
+/**
+ * Fixed ring of the latest events of one thread. Only its owner thread
+ * records, without locks; readers copy it concurrently and discard the slots
+ * overwritten meanwhile.
+ */
+class RIEL_EXPORT Ring {
+public:
+  static constexpr std::size_t kCapacity = 4096;
+
+  explicit Ring(const std::size_t id) noexcept
+      : id_{id}, head_{0}, claimed_{0}, floor_{0}, slots_{} {}
+
+  ~Ring();
+
+  void Record(const char *       name,
+              const std::uint64_t begin,
+              const std::uint64_t end) noexcept {
+    const std::uint64_t head = head_.load(std::memory_order_relaxed);
+    Slot &              slot = slots_[head % kCapacity];
+
+    // Claims the slot before overwriting it, so readers can tell.
+    claimed_.store(head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  /** Appends the events still held, oldest first. */
+  void Snapshot(std::vector<Event> &events) const {
+    const std::uint64_t head = head_.load(std::memory_order_acquire);
+    const std::uint64_t first =
+        std::max(floor_.load(std::memory_order_relaxed),
+                 head > kCapacity ? head - kCapacity : 0);
+
+    std::vector<Event> copied;
+    for (std::uint64_t i = first; i < head; ++i) {
+      const Slot &slot = slots_[i % kCapacity];
+      copied.push_back({slot.name.load(std::memory_order_relaxed),
+                        slot.begin.load(std::memory_order_relaxed),
+                        slot.end.load(std::memory_order_relaxed)});
+    }
+
+    // The owner may have claimed the oldest slots while they were copied.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const std::uint64_t claimed = claimed_.load(std::memory_order_relaxed);
+    const std::uint64_t valid = claimed > kCapacity ? claimed - kCapacity : 0;
+    for (std::uint64_t i = first; i < head; ++i) {
+      if (i >= valid) { events.push_back(copied[i - first]); }
+    }
+  }
+
+  /** Hides the events recorded so far from later snapshots. */
+  void Clear() noexcept {
+    floor_.store(head_.load(std::memory_order_acquire),
+                 std::memory_order_relaxed);
+  }
+
+  std::size_t id() const noexcept { return id_; }
+
+private:
+  struct Slot {
+    std::atomic<const char *>  name;
+    std::atomic<std::uint64_t> begin;
+    std::atomic<std::uint64_t> end;
+  };
+
+  const std::size_t          id_;
+  std::atomic<std::uint64_t> head_;
+  std::atomic<std::uint64_t> claimed_;
+  std::atomic<std::uint64_t> floor_;
+  Slot                       slots_[kCapacity];
+
+  RIEL_DISALLOW_ALL(Ring);
+};
+
+/**
+ * Process wide registry of rings. Each thread takes a ring on its first
+ * event and hands it back when it exits, so short lived threads reuse rings
+ * and keep their events readable.
+ */
+class RIEL_EXPORT Tracer {
+public:
+  static std::uint64_t Now() noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+
+  static void Record(const char *       name,
+                     const std::uint64_t begin,
+                     const std::uint64_t end) noexcept {
+    Local().Record(name, begin, end);
+  }
+
+  /** Events of every ring, each with the id of its ring. */
+  static std::vector<std::pair<std::size_t, Event>> Collect();
+
+  /** Writes the events in the Chrome trace event format. */
+  static void Export(std::ostream &ostream);
+
+  static void Clear();
+
+private:
+  static Ring &Local() noexcept;
+};
+
+/**
+ * Records the lifetime of the span as an event. `name` must outlive the
+ * export, as string literals do.
+ */
+class RIEL_EXPORT Span {
+public:
+  explicit Span(const char *name) noexcept
+      : name_{name}, begin_{Tracer::Now()} {}
+
+  ~Span() { Tracer::Record(name_, begin_, Tracer::Now()); }
+
+private:
+  const char *const   name_;
+  const std::uint64_t begin_;
+
+  RIEL_DISALLOW_ALL(Span);
+};
+
+}  // namespace tracing
+
 // = = =
 // Node
 // = = =
@@ -68,10 +561,13 @@ struct Type {
     UNION,
     PROJECT,
     SCAN,
+    FILTER,
+    JOIN,
+    SORT,
   };
 };
 
-class RIEL_EXPORT Node {
+class RIEL_EXPORT Node : public memory::Tracked {
 public:
   virtual ~Node();
 
@@ -81,6 +577,9 @@ public:
 
   virtual void Accept(const class Visitor &) const = 0;
 
+  /** Copy of this node without its children. */
+  virtual std::unique_ptr<Node> Clone() const = 0;
+
 protected:
   inline Node() = default;
 
@@ -181,7 +680,12 @@ public:
   virtual const_iterator end() const noexcept   = 0;
 };
 
-class ContiguousChildren : public ContiguousIterator<std::vector> {
+/** Vector charging the tracker in scope when it was created. */
+template <class T = std::unique_ptr<Node>, class...>
+using TrackedVector = std::vector<T, memory::Allocator<T>>;
+
+class ContiguousChildren : public ContiguousIterator<TrackedVector>,
+                           public memory::Tracked {
 public:
   inline ContiguousChildren() = default;
   ~ContiguousChildren() final;
@@ -201,7 +705,7 @@ public:
   const_iterator end() const noexcept final { return nodes_.end(); }
 
 private:
-  std::vector<std::unique_ptr<Node>> nodes_;
+  TrackedVector<> nodes_;
 
   RIEL_DISALLOW_ALL(ContiguousChildren);
 };
@@ -250,6 +754,11 @@ class RIEL_INTERNAL RepresentableNode : public ContiguousNode,
     return ostream << OStreamNode{node.get(), 0};
   }
 
+  friend inline std::ostream &operator<<(std::ostream &           ostream,
+                                         const RepresentableNode &node) {
+    return ostream << OStreamNode{&node, 0};
+  }
+
 public:
   ~RepresentableNode() override;
 
@@ -306,7 +815,8 @@ private:
 
 class RIEL_EXPORT ScanNode : public RepresentableNode {
 public:
-  explicit ScanNode(const std::vector<std::string> &&path) : path_{path} {}
+  explicit ScanNode(const std::vector<std::string> &&path)
+      : path_{path}, payload_{memory::Payload(path_)} {}
 
   ~ScanNode() final;
 
@@ -314,6 +824,10 @@ public:
 
   Type::type id() const noexcept final { return Type::SCAN; }
 
+  std::unique_ptr<Node> Clone() const final {
+    return std::make_unique<ScanNode>(std::vector<std::string>{path_});
+  }
+
   void Accept(const Visitor & /*visitor*/) const final;
 
   explicit operator std::string() const noexcept final {
@@ -327,6 +841,7 @@ public:
 
 private:
   const std::vector<std::string> path_;
+  const memory::Reservation      payload_;
 
   RIEL_DISALLOW_ALL(ScanNode);
 };
@@ -341,6 +856,10 @@ public:
 
   Type::type id() const noexcept final { return Type::UNION; }
 
+  std::unique_ptr<Node> Clone() const final {
+    return std::make_unique<UnionNode>(all_);
+  }
+
   void Accept(const Visitor & /*visitor*/) const final;
 
   explicit operator std::string() const noexcept final {
@@ -358,7 +877,8 @@ private:
 class RIEL_EXPORT AggregateNode : public RepresentableNode {
 public:
   explicit AggregateNode(std::vector<std::size_t> &&group_indices)
-      : group_indices_{std::move(group_indices)} {}
+      : group_indices_{std::move(group_indices)},
+        payload_{memory::Payload(group_indices_)} {}
 
   ~AggregateNode() final;
 
@@ -368,6 +888,11 @@ public:
 
   Type::type id() const noexcept final { return Type::AGGREGATE; }
 
+  std::unique_ptr<Node> Clone() const final {
+    return std::make_unique<AggregateNode>(
+        std::vector<std::size_t>{group_indices_});
+  }
+
   void Accept(const Visitor & /*visitor*/) const final;
 
   explicit operator std::string() const noexcept final {
@@ -380,7 +905,8 @@ public:
   }
 
 private:
-  std::vector<std::size_t> group_indices_;
+  std::vector<std::size_t>  group_indices_;
+  const memory::Reservation payload_;
 
   RIEL_DISALLOW_ALL(AggregateNode);
 };
@@ -389,7 +915,7 @@ class RIEL_EXPORT ProjectNode : public RepresentableNode {
 public:
   explicit ProjectNode(
       const std::vector<std::pair<std::string, std::size_t>> &&pairs)
-      : pairs_{pairs} {}
+      : pairs_{pairs}, payload_{Payload(pairs_)} {}
 
   ~ProjectNode() final;
 
@@ -399,6 +925,11 @@ public:
 
   Type::type id() const noexcept final { return Type::PROJECT; }
 
+  std::unique_ptr<Node> Clone() const final {
+    return std::make_unique<ProjectNode>(
+        std::vector<std::pair<std::string, std::size_t>>{pairs_});
+  }
+
   void Accept(const Visitor & /*visitor*/) const final;
 
   explicit operator std::string() const noexcept final {
@@ -417,11 +948,275 @@ public:
   }
 
 private:
+  static std::size_t
+  Payload(const std::vector<std::pair<std::string, std::size_t>> &pairs) {
+    std::size_t bytes = pairs.capacity() * sizeof(pairs[0]);
+    for (const auto &pair : pairs) { bytes += memory::Payload(pair.first); }
+    return bytes;
+  }
+
   std::vector<std::pair<std::string, std::size_t>> pairs_;
+  const memory::Reservation                        payload_;
 
   RIEL_DISALLOW_ALL(ProjectNode);
 };
 
+// = = = = = =
+// Conditions
+// = = = = = =
+
+using Literal = std::variant<std::int64_t, std::string>;
+
+struct Comparator {
+  enum type : std::size_t {
+    EQUALS,
+    NOT_EQUALS,
+    LESS_THAN,
+    LESS_THAN_OR_EQUAL,
+    GREATER_THAN,
+    GREATER_THAN_OR_EQUAL,
+  };
+
+  static const char *symbol(const type comparator) noexcept {
+    static const char *const symbols[] = {"=", "<>", "<", "<=", ">", ">="};
+    return symbols[comparator];
+  }
+};
+
+/**
+ * Compares the input column `index` against a literal, e.g. `>($2, 10)`.
+ */
+struct RIEL_EXPORT Comparison {
+  std::size_t      index;
+  Literal          literal;
+  Comparator::type comparator;
+
+  bool operator==(const Comparison &other) const {
+    return index == other.index && literal == other.literal &&
+           comparator == other.comparator;
+  }
+
+  explicit operator std::string() const {
+    std::ostringstream stream{std::ios_base::out};
+    stream << Comparator::symbol(comparator) << "($" << index << ", ";
+    if (const auto *integer = std::get_if<std::int64_t>(&literal)) {
+      stream << *integer;
+    } else {
+      // Quotes within the literal are doubled, as in SQL.
+      stream << '\'';
+      for (const char c : std::get<std::string>(literal)) {
+        stream << c;
+        if ('\'' == c) { stream << c; }
+      }
+      stream << '\'';
+    }
+    stream << ")";
+    return stream.str();
+  }
+};
+
+/**
+ * Keeps the rows satisfying every comparison of its conjunction.
+ */
+class RIEL_EXPORT FilterNode : public RepresentableNode {
+public:
+  explicit FilterNode(std::vector<Comparison> &&conjuncts)
+      : conjuncts_{std::move(conjuncts)}, payload_{Payload(conjuncts_)} {}
+
+  ~FilterNode() final;
+
+  const std::vector<Comparison> &conjuncts() const { return conjuncts_; }
+
+  Type::type id() const noexcept final { return Type::FILTER; }
+
+  std::unique_ptr<Node> Clone() const final {
+    return std::make_unique<FilterNode>(std::vector<Comparison>{conjuncts_});
+  }
+
+  void Accept(const Visitor & /*visitor*/) const final;
+
+  explicit operator std::string() const noexcept final {
+    std::ostringstream stream{std::ios_base::out};
+    stream << "Filter(condition=[";
+    if (1 == conjuncts_.size()) {
+      stream << static_cast<std::string>(conjuncts_[0]);
+    } else {
+      stream << "AND(";
+      inserts(stream, conjuncts_, [](const auto &conjunct) {
+        return static_cast<std::string>(conjunct);
+      });
+      stream << ")";
+    }
+    stream << "])";
+
+    return stream.str();
+  }
+
+private:
+  static std::size_t Payload(const std::vector<Comparison> &conjuncts) {
+    std::size_t bytes = conjuncts.capacity() * sizeof(conjuncts[0]);
+    for (const auto &conjunct : conjuncts) {
+      if (const auto *string = std::get_if<std::string>(&conjunct.literal)) {
+        bytes += memory::Payload(*string);
+      }
+    }
+    return bytes;
+  }
+
+  std::vector<Comparison>   conjuncts_;
+  const memory::Reservation payload_;
+
+  RIEL_DISALLOW_ALL(FilterNode);
+};
+
+struct JoinType {
+  enum type : std::size_t {
+    INNER,
+  };
+
+  static const char *name(const type join_type) noexcept {
+    static const char *const names[] = {"inner"};
+    return names[join_type];
+  }
+};
+
+/**
+ * Equi-join of its two children. Keys index the concatenation of the left and
+ * right fields, so `=($0, $3)` over a two-field left input matches the first
+ * left field with the second right one.
+ */
+class RIEL_EXPORT JoinNode : public RepresentableNode {
+public:
+  using Key = std::pair<std::size_t, std::size_t>;
+
+  JoinNode(std::vector<Key> &&keys, const JoinType::type join_type)
+      : keys_{std::move(keys)}, join_type_{join_type},
+        payload_{memory::Payload(keys_)} {}
+
+  ~JoinNode() final;
+
+  const std::vector<Key> &keys() const { return keys_; }
+
+  JoinType::type join_type() const { return join_type_; }
+
+  Type::type id() const noexcept final { return Type::JOIN; }
+
+  std::unique_ptr<Node> Clone() const final {
+    return std::make_unique<JoinNode>(std::vector<Key>{keys_}, join_type_);
+  }
+
+  void Accept(const Visitor & /*visitor*/) const final;
+
+  explicit operator std::string() const noexcept final {
+    std::ostringstream stream{std::ios_base::out};
+    stream << "Join(condition=[";
+    if (1 != keys_.size()) { stream << "AND("; }
+    inserts(
+        stream,
+        keys_,
+        "=($",
+        [](const auto &key) { return std::to_string(key.first); },
+        ", $",
+        [](const auto &key) { return std::to_string(key.second); },
+        ")");
+    if (1 != keys_.size()) { stream << ")"; }
+    stream << "], joinType=[" << JoinType::name(join_type_) << "])";
+
+    return stream.str();
+  }
+
+private:
+  std::vector<Key>          keys_;
+  const JoinType::type      join_type_;
+  const memory::Reservation payload_;
+
+  RIEL_DISALLOW_ALL(JoinNode);
+};
+
+struct Direction {
+  enum type : std::size_t {
+    ASCENDING,
+    DESCENDING,
+  };
+
+  static const char *name(const type direction) noexcept {
+    static const char *const names[] = {"ASC", "DESC"};
+    return names[direction];
+  }
+};
+
+/**
+ * Orders its input on the keys, most significant first, and keeps only the
+ * first `fetch` rows when given. Without keys it just limits its input.
+ */
+class RIEL_EXPORT SortNode : public RepresentableNode {
+public:
+  struct Key {
+    std::size_t     index;
+    Direction::type direction;
+
+    bool operator==(const Key &other) const {
+      return index == other.index && direction == other.direction;
+    }
+  };
+
+  SortNode(std::vector<Key> &&keys, const std::optional<std::size_t> fetch)
+      : keys_{std::move(keys)}, fetch_{fetch},
+        payload_{memory::Payload(keys_)} {}
+
+  ~SortNode() final;
+
+  const std::vector<Key> &keys() const { return keys_; }
+
+  const std::optional<std::size_t> &fetch() const { return fetch_; }
+
+  Type::type id() const noexcept final { return Type::SORT; }
+
+  std::unique_ptr<Node> Clone() const final {
+    return std::make_unique<SortNode>(std::vector<Key>{keys_}, fetch_);
+  }
+
+  void Accept(const Visitor & /*visitor*/) const final;
+
+  explicit operator std::string() const noexcept final {
+    std::vector<std::string> properties;
+    for (std::size_t i = 0; i < keys_.size(); ++i) {
+      properties.push_back("sort" + std::to_string(i) + "=[$" +
+                           std::to_string(keys_[i].index) + "]");
+    }
+    for (std::size_t i = 0; i < keys_.size(); ++i) {
+      properties.push_back("dir" + std::to_string(i) + "=[" +
+                           Direction::name(keys_[i].direction) + "]");
+    }
+    if (fetch_) {
+      properties.push_back("fetch=[" + std::to_string(*fetch_) + "]");
+    }
+
+    std::ostringstream stream{std::ios_base::out};
+    stream << "Sort(";
+    inserts(stream, properties);
+    stream << ")";
+
+    return stream.str();
+  }
+
+private:
+  std::vector<Key>                 keys_;
+  const std::optional<std::size_t> fetch_;
+  const memory::Reservation        payload_;
+
+  RIEL_DISALLOW_ALL(SortNode);
+};
+
+/**
+ * Text format of the tree rooted at `node`, as read by StreamParser.
+ */
+inline std::string Format(const Node &node) {
+  std::ostringstream stream{std::ios_base::out};
+  stream << dynamic_cast<const RepresentableNode &>(node);
+  return stream.str();
+}
+
 class RIEL_EXPORT Visitor {
 public:
   virtual ~Visitor();
@@ -435,8 +1230,15 @@ public:
   VISIT_NODE(UnionNode)
   VISIT_NODE(AggregateNode)
   VISIT_NODE(ProjectNode)
+  VISIT_NODE(FilterNode)
+  VISIT_NODE(JoinNode)
+  VISIT_NODE(SortNode)
 
 #undef VISIT
+
+protected:
+  inline Visitor() = default;
+
 private:
   RIEL_DISALLOW_ALL(Visitor);
 };
@@ -447,7 +1249,7 @@ namespace building {
 // Builder
 // = = = =
 
-class Builder {
+class Builder : public memory::Tracked {
 public:
   virtual ~Builder();
 
@@ -494,6 +1296,8 @@ public:
   ~UnionPropertiesBuilder() final;
 
   std::unique_ptr<Node> Build() final {
+    RIEL_TRACE("UnionPropertiesBuilder::Build");
+
     if (1 != properties().size()) {
       throw std::runtime_error("Bad union properties with size = " +
                                std::to_string(properties().size()));
@@ -525,6 +1329,8 @@ public:
   ~ScanPropertiesBuilder() final;
 
   std::unique_ptr<Node> Build() final {
+    RIEL_TRACE("ScanPropertiesBuilder::Build");
+
     if (1 != properties().size()) {
       throw std::runtime_error("Bad scan properties builder size = " +
                                std::to_string(properties().size()));
@@ -559,6 +1365,8 @@ public:
   ~AggregatePropertiesBuilder() final;
 
   std::unique_ptr<Node> Build() final {
+    RIEL_TRACE("AggregatePropertiesBuilder::Build");
+
     if (1 != properties().size()) {
       throw std::runtime_error("Bad union properties with size = " +
                                std::to_string(properties().size()));
@@ -596,6 +1404,8 @@ public:
   ~ProjectPropertiesBuilder() final;
 
   std::unique_ptr<Node> Build() final {
+    RIEL_TRACE("ProjectPropertiesBuilder::Build");
+
     if (properties().empty()) {
       throw std::runtime_error("Bad project properties builder size = " +
                                std::to_string(properties().size()));
@@ -618,6 +1428,251 @@ private:
   RIEL_DISALLOW_ALL(ProjectPropertiesBuilder);
 };
 
+class FilterPropertiesBuilder : public PropertiesBuilder {
+public:
+  using PropertiesBuilder::PropertiesBuilder;
+
+  ~FilterPropertiesBuilder() final;
+
+  std::unique_ptr<Node> Build() final {
+    RIEL_TRACE("FilterPropertiesBuilder::Build");
+
+    if (1 != properties().size()) {
+      throw std::runtime_error("Bad filter properties builder size = " +
+                               std::to_string(properties().size()));
+    }
+
+    const Property &property = properties()[0];
+
+    if ("condition" != property.first) {
+      throw std::runtime_error("Filter property builder with property " +
+                               property.first);
+    }
+
+    std::vector<Comparison> conjuncts;
+
+    const std::string &condition = property.second;
+    if (0 == condition.compare(0, 4, "AND(") && ')' == condition.back()) {
+      std::size_t begin  = 4;
+      std::size_t depth  = 0;
+      bool        quoted = false;
+      for (std::size_t i = begin; i < condition.size() - 1; ++i) {
+        // A doubled quote within a literal closes and reopens it.
+        if ('\'' == condition[i]) { quoted = !quoted; }
+        if (quoted) { continue; }
+        if ('(' == condition[i]) { ++depth; }
+        if (')' == condition[i]) { --depth; }
+        if (',' == condition[i] && 0 == depth) {
+          conjuncts.push_back(
+              MakeComparison(condition.substr(begin, i - begin)));
+          begin = i + 1;
+        }
+      }
+      conjuncts.push_back(MakeComparison(
+          condition.substr(begin, condition.size() - 1 - begin)));
+    } else {
+      conjuncts.push_back(MakeComparison(condition));
+    }
+
+    return std::make_unique<FilterNode>(std::move(conjuncts));
+  }
+
+private:
+  static Comparison MakeComparison(const std::string &format) {
+    std::regex re{
+        "^\\s*(=|<>|<=|>=|<|>)"    // comparator
+        "\\(\\$(\\d+),\\s*"        // column
+        "(-?\\d+|'(?:[^']|'')*')"  // literal, quotes doubled
+        "\\)\\s*$",
+        std::regex::ECMAScript};
+    std::smatch match{std::smatch::allocator_type()};
+
+    if (!std::regex_match(
+            format, match, re, std::regex_constants::match_default)) {
+      throw std::runtime_error("Unsupported condition: '" + format + "'");
+    }
+
+    const int         base   = 10;
+    const std::string symbol = match.str(1);
+    const std::string value  = match.str(3);
+
+    Comparison comparison{
+        std::stoul(match.str(2), nullptr, base),
+        Literal{},
+        Comparator::EQUALS,
+    };
+    while (symbol != Comparator::symbol(comparison.comparator)) {
+      comparison.comparator =
+          static_cast<Comparator::type>(comparison.comparator + 1);
+    }
+    if ('\'' == value[0]) {
+      std::string literal;
+      for (std::size_t i = 1; i + 1 < value.size(); ++i) {
+        literal.push_back(value[i]);
+        if ('\'' == value[i]) { ++i; }
+      }
+      comparison.literal = std::move(literal);
+    } else {
+      comparison.literal = std::int64_t{std::stoll(value, nullptr, base)};
+    }
+    return comparison;
+  }
+
+  RIEL_DISALLOW_ALL(FilterPropertiesBuilder);
+};
+
+class JoinPropertiesBuilder : public PropertiesBuilder {
+public:
+  using PropertiesBuilder::PropertiesBuilder;
+
+  ~JoinPropertiesBuilder() final;
+
+  std::unique_ptr<Node> Build() final {
+    RIEL_TRACE("JoinPropertiesBuilder::Build");
+
+    if (2 != properties().size()) {
+      throw std::runtime_error("Bad join properties builder size = " +
+                               std::to_string(properties().size()));
+    }
+
+    std::vector<JoinNode::Key> keys;
+    JoinType::type             join_type = JoinType::INNER;
+
+    for (const auto &property : properties()) {
+      if ("condition" == property.first) {
+        keys = MakeKeys(property.second);
+      } else if ("joinType" == property.first) {
+        if (JoinType::name(JoinType::INNER) != property.second) {
+          throw std::runtime_error("Unsupported join type " + property.second);
+        }
+        join_type = JoinType::INNER;
+      } else {
+        throw std::runtime_error("Join property builder with property " +
+                                 property.first);
+      }
+    }
+
+    if (keys.empty()) {
+      throw std::runtime_error("Join property builder without condition");
+    }
+
+    return std::make_unique<JoinNode>(std::move(keys), join_type);
+  }
+
+private:
+  static std::vector<JoinNode::Key> MakeKeys(const std::string &condition) {
+    const std::string equals = "=\\(\\$(\\d+),\\s*\\$(\\d+)\\)";
+
+    std::regex whole{"^(?:" + equals + "|AND\\(" + equals +
+                         "(?:,\\s*" + equals + ")+\\))$",
+                     std::regex::ECMAScript};
+    if (!std::regex_match(condition, whole)) {
+      throw std::runtime_error("Unsupported join condition: '" + condition +
+                               "'");
+    }
+
+    std::regex                 re{equals, std::regex::ECMAScript};
+    const int                  base = 10;
+    std::vector<JoinNode::Key> keys;
+    for (std::sregex_iterator it{condition.cbegin(), condition.cend(), re}, end;
+         end != it;
+         ++it) {
+      keys.emplace_back(std::stoul(it->str(1), nullptr, base),
+                        std::stoul(it->str(2), nullptr, base));
+    }
+    return keys;
+  }
+
+  RIEL_DISALLOW_ALL(JoinPropertiesBuilder);
+};
+
+class SortPropertiesBuilder : public PropertiesBuilder {
+public:
+  using PropertiesBuilder::PropertiesBuilder;
+
+  ~SortPropertiesBuilder() final;
+
+  std::unique_ptr<Node> Build() final {
+    RIEL_TRACE("SortPropertiesBuilder::Build");
+
+    std::regex re{"^(sort|dir)(\\d+)$", std::regex::ECMAScript};
+    const int  base = 10;
+
+    std::map<std::size_t, std::size_t>     indices;
+    std::map<std::size_t, Direction::type> directions;
+    std::optional<std::size_t>             fetch;
+
+    for (const auto &property : properties()) {
+      std::smatch match{std::smatch::allocator_type()};
+      if ("fetch" == property.first) {
+        fetch = MakeCount(property);
+      } else if (std::regex_match(property.first, match, re)) {
+        const std::size_t position = std::stoul(match.str(2), nullptr, base);
+        if ("sort" == match.str(1)) {
+          indices[position] = MakeIndex(property);
+        } else {
+          directions[position] = MakeDirection(property);
+        }
+      } else {
+        throw std::runtime_error("Sort property builder with property " +
+                                 property.first);
+      }
+    }
+
+    std::vector<SortNode::Key> keys;
+    for (const auto &index : indices) {
+      const auto direction = directions.find(index.first);
+      if (keys.size() != index.first || directions.cend() == direction) {
+        throw std::runtime_error("Sort property builder without dir" +
+                                 std::to_string(keys.size()));
+      }
+      keys.push_back({index.second, direction->second});
+    }
+    if (keys.size() != directions.size()) {
+      throw std::runtime_error("Sort property builder without sort" +
+                               std::to_string(keys.size()));
+    }
+    if (keys.empty() && !fetch) {
+      throw std::runtime_error("Sort property builder without keys or fetch");
+    }
+
+    return std::make_unique<SortNode>(std::move(keys), fetch);
+  }
+
+private:
+  static std::size_t MakeIndex(const Property &property) {
+    if ('$' != property.second[0]) {
+      throw std::runtime_error("Sort property builder with value " +
+                               property.second);
+    }
+    return MakeCount({property.first, property.second.substr(1)});
+  }
+
+  static std::size_t MakeCount(const Property &property) {
+    if (property.second.empty() ||
+        std::string::npos !=
+            property.second.find_first_not_of("0123456789")) {
+      throw std::runtime_error("Sort property builder with value " +
+                               property.second);
+    }
+    const int base = 10;
+    return std::stoul(property.second, nullptr, base);
+  }
+
+  static Direction::type MakeDirection(const Property &property) {
+    if (Direction::name(Direction::ASCENDING) == property.second) {
+      return Direction::ASCENDING;
+    }
+    if (Direction::name(Direction::DESCENDING) == property.second) {
+      return Direction::DESCENDING;
+    }
+    throw std::runtime_error("Sort property builder with value " +
+                             property.second);
+  }
+
+  RIEL_DISALLOW_ALL(SortPropertiesBuilder);
+};
+
 }  // namespace building
 
 // = = = =
@@ -648,15 +1703,23 @@ public:
   ~StreamParser() final;
 
   std::unique_ptr<Node> parse() final {
+    RIEL_TRACE("StreamParser::parse");
+
     std::getline(istream_, format);
     auto root = MakeNode(format);
-    std::getline(istream_, format);
+    NextLine();
     level = 1;
     Traverse(root);
     return root;
   }
 
 private:
+  // A plan whose last line lacks the newline leaves `format` untouched on
+  // the next read, so clear it to end the traversal.
+  void NextLine() {
+    if (!std::getline(istream_, format)) { format.clear(); }
+  }
+
   void Traverse(const std::unique_ptr<Node> &parent) {
     while (!format.empty()) {
       if (format[level] != ' ') {
@@ -664,7 +1727,7 @@ private:
         break;
       }
       auto node = MakeNode(format);
-      std::getline(istream_, format);
+      NextLine();
       level += 2;
       Traverse(node);
       parent->children().append(std::move(node));
@@ -674,37 +1737,40 @@ private:
   using Arguments = std::vector<std::pair<std::string, std::string>>;
 
   static std::unique_ptr<Node> MakeNode(const std::string &format) {
-    std::regex re{
-        "^\\s*"                // indent
-        "(\\w+)"               // node name
-        "\\("                  // start arguments
-        "([[:alpha:]]+)=\\[("  // start first
-        "[[:lower:]]+"
-        "|\\$\\d+"
-        "|\\{\\d+(?:,\\s*\\d+)*\\}"
-        "|\\[[[:upper:]]+(?:,\\s*[[:upper:]]+)*\\]"
-        ")\\]"  // end first
-        "(?:,\\s*"
-        "(?:([[:alpha:]]+)=\\[("
-        "[[:lower:]]+"
-        "|\\$\\d+"
-        "|\\{\\d+(?:,\\s*\\d+)*\\}"
-        "|\\[[[:upper:]]+(?:,\\s*[[:upper:]]+)*\\]"
-        ")\\])"
-        ")*"
-        "\\)$",
-        std::regex::ECMAScript};
+    RIEL_TRACE("StreamParser::MakeNode");
+
+    // A repeated group only captures its last repetition, so the whole line
+    // is checked first and its properties are then matched one by one.
+    const std::string property = "([[:alpha:]]\\w*)=\\[("
+                                 "[[:lower:]]+"
+                                 "|[[:upper:]]+"
+                                 "|\\d+"
+                                 "|\\$\\d+"
+                                 "|\\{\\d+(?:,\\s*\\d+)*\\}"
+                                 "|\\[[[:upper:]]+(?:,\\s*[[:upper:]]+)*\\]"
+                                 "|[[:upper:]=<>]+\\("
+                                 "(?:[^\\]']|'(?:[^']|'')*')*\\)"
+                                 ")\\]";
+    std::regex re{"^\\s*"   // indent
+                  "(\\w+)"  // node name
+                  "\\(("    // start arguments
+                      + property + "(?:,\\s*" + property + ")*" +
+                      ")\\)$",  // end arguments
+                  std::regex::ECMAScript};
     std::smatch match{std::smatch::allocator_type()};
 
     if (std::regex_match(
             format, match, re, std::regex_constants::match_default)) {
       const std::string name = match.str(1);
+      const std::string list = match.str(2);
+      const std::regex  each{property, std::regex::ECMAScript};
 
       Arguments arguments;
 
-      for (std::size_t i = 2; i < match.size(); i += 2) {
-        if (match[i].length() == 0) { break; }
-        arguments.emplace_back(std::make_pair(match.str(i), match.str(i + 1)));
+      for (std::sregex_iterator it{list.cbegin(), list.cend(), each}, end;
+           end != it;
+           ++it) {
+        arguments.emplace_back(std::make_pair(it->str(1), it->str(2)));
       }
 
       const auto builder = MakePropertiesBuilder(name, std::move(arguments));
@@ -727,6 +1793,9 @@ private:
     MAKE_BUILDER(Union);
     MAKE_BUILDER(Project);
     MAKE_BUILDER(Scan);
+    MAKE_BUILDER(Filter);
+    MAKE_BUILDER(Join);
+    MAKE_BUILDER(Sort);
 
     throw std::runtime_error("Unreachable MakePropertiesBuilder");
 